@@ -0,0 +1,366 @@
+
+// File:    batch.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Headless batch mode for scripted runs ("ncgol run ...").
+//          Without ncurses and without the simulation thread the generations are
+//          calculated directly in batches of grid_update_n() without any time budget.
+//          The batches only end at the next statistics line, at the requested number
+//          of generations or at the end detection. The history for going back in
+//          time is switched off, nothing is kept which is not written at the end.
+//          Many runs can be started in parallel, every run only writes its own files.
+//          With "--shards" the grid is split into columns for several worker processes
+//          (see shard.c), the results are the same.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include "config.h"
+#include "batch.h"
+#include "grid.h"
+#include "end_det.h"
+#include "history.h"
+#include "patfile.h"
+#include "shard.h"
+#include "timing.h"
+
+#define BATCH_SIZE_DEFAULT_W 400
+#define BATCH_SIZE_DEFAULT_H 200
+#define BATCH_INTERVAL_DEFAULT 100 // Generations between two statistics lines
+
+static FILE     *stats_file = NULL;
+static uint64_t start_ms    = 0;
+
+
+
+// Function to read a number of an option (only digits, within "min" and "max")
+// -> Returns "1" if the number is valid
+static uint8_t batch_parse_uint(const char * str, uint32_t min, uint32_t max, uint32_t * val)
+{
+    char               *end;
+    unsigned long long num;
+
+    if((*str < '0') || (*str > '9'))
+    {
+        return 0;
+    }
+    errno = 0;
+    num   = strtoull(str, &end, 10);
+    if((errno != 0) || (*end != '\0') || (num < min) || (num > max))
+    {
+        return 0;
+    }
+    *val = num;
+    return 1;
+}
+
+
+
+// Function to print the help of the batch mode
+static void batch_help(void)
+{
+    printf("Usage:\n");
+    printf("  ncgol run [options]\n");
+    printf("\n");
+    printf("Runs a simulation without terminal output at full speed\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  -g, --gens       Generations to calculate (0: until the end is detected, default)\n");
+    printf("  -h, --help       This Help\n");
+    printf("  -i, --interval   Generations between two statistics lines (default %u)\n", BATCH_INTERVAL_DEFAULT);
+    printf("  -j, --shards     Worker processes which calculate parts of the grid (1-%u, default 1)\n", SHARD_MAX);
+    printf("  -l, --load       Load initial pattern from file (\"-\": stdin)\n");
+    printf("  -o, --out        Write the last generation as RLE file (\"-\": stdout)\n");
+    printf("  -p, --pattern    Set initial pattern (default random):\n");
+    for(int i=0; i<INITPATTERN_CYCLEMAX; i++)
+        printf("                   - %-9s -> %s\n", grid_get_initpattern_short_str(i), grid_get_initpattern_long_str(i));
+    printf("  -S, --seed       Seed for the random pattern (default 1)\n");
+    printf("  -s, --size       Grid size WxH (maximum %ux%u, default %ux%u)\n", GRID_WIDTH_MAX, GRID_HEIGHT_MAX, BATCH_SIZE_DEFAULT_W, BATCH_SIZE_DEFAULT_H);
+    printf("  -t, --stats      Write statistics as JSON lines (\"-\": stdout)\n");
+    printf("  -w, --window     Cycles which have to repeat for the end detection (50-%i, default %i)\n", END_DET_WINDOW_MAX, END_DET_WINDOW_DEFAULT);
+}
+
+
+
+// Function to write one statistics line
+static void batch_print_stats(const shard_stats_t * stats)
+{
+    if(stats_file == NULL)
+    {
+        return;
+    }
+    fprintf(stats_file, "{\"generation\":%u,\"cycles\":%u,\"alive\":%u,\"hash\":\"%016llx\",\"end\":%u,\"period\":%u,\"ms\":%llu}\n",
+            stats->generation, stats->cycle_counter, stats->cells_alive, (unsigned long long)stats->hash,
+            stats->end_detected, stats->period, (unsigned long long)(timing_now_ms() - start_ms));
+}
+
+
+
+// Function to write one statistics line of the current generation
+static void batch_write_stats(void)
+{
+    grid_state_t  state;
+    shard_stats_t stats;
+
+    grid_get_state(&state);
+    stats.generation    = grid_get_generation();
+    stats.cycle_counter = grid_get_cycle_counter();
+    stats.cells_alive   = state.cells_alive;
+    stats.hash          = state.hash;
+    stats.end_detected  = grid_end_detected();
+    stats.period        = grid_get_period();
+    batch_print_stats(&stats);
+}
+
+
+
+// Function to close the statistics and to write the last generation
+// -> Returns the exit code of the program
+static int batch_finish(const char * out_path, const char * stats_path, uint32_t generation)
+{
+    if((stats_file != NULL) && (stats_file != stdout) && (fclose(stats_file) != 0))
+    {
+        fprintf(stderr, "Statistics file %s can not be written\n", stats_path);
+        return 1;
+    }
+    if((out_path != NULL) && !patfile_save_rle(out_path, (const grid_t *)grid_get(), grid_get_width(), grid_get_height(), generation))
+    {
+        fprintf(stderr, "Export to %s failed\n", out_path);
+        return 1;
+    }
+    return 0;
+}
+
+
+
+// Run a simulation without terminal output with the arguments after "run"
+// -> Returns the exit code of the program
+int batch_main(int argc, char * argv[])
+{
+    initpattern_t pattern  = INITPATTERN_RANDOM;
+    uint32_t      gens     = 0;
+    uint32_t      interval = BATCH_INTERVAL_DEFAULT;
+    uint32_t      shards   = 1;
+    uint32_t      width    = BATCH_SIZE_DEFAULT_W;
+    uint32_t      height   = BATCH_SIZE_DEFAULT_H;
+    uint32_t      window   = END_DET_WINDOW_DEFAULT;
+    const char    *out_path   = NULL;
+    const char    *stats_path = NULL;
+
+    while(1)
+    {
+        static struct option long_options[] =
+        {
+            {"gens",     required_argument, 0, 'g'},
+            {"help",     no_argument,       0, 'h'},
+            {"interval", required_argument, 0, 'i'},
+            {"shards",   required_argument, 0, 'j'},
+            {"load",     required_argument, 0, 'l'},
+            {"out",      required_argument, 0, 'o'},
+            {"pattern",  required_argument, 0, 'p'},
+            {"seed",     required_argument, 0, 'S'},
+            {"size",     required_argument, 0, 's'},
+            {"stats",    required_argument, 0, 't'},
+            {"window",   required_argument, 0, 'w'},
+            {0, 0, 0, 0}
+        };
+
+        int c = getopt_long(argc, argv, "g:hi:j:l:o:p:S:s:t:w:", long_options, 0);
+        if(c == -1)
+        {
+            break;
+        }
+
+        switch(c)
+        {
+            case 'g':
+            {
+                if(!batch_parse_uint(optarg, 0, UINT32_MAX, &gens))
+                {
+                    fprintf(stderr, "Invalid gens value: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+
+            case 'h':
+            {
+                batch_help();
+                return 0;
+            }
+
+            case 'i':
+            {
+                if(!batch_parse_uint(optarg, 0, UINT32_MAX, &interval))
+                {
+                    fprintf(stderr, "Invalid interval value: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+
+            case 'j':
+            {
+                if(!batch_parse_uint(optarg, 1, SHARD_MAX, &shards))
+                {
+                    fprintf(stderr, "Invalid shards value: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+
+            case 'l':
+            {
+                if(!patfile_open(optarg))
+                {
+                    fprintf(stderr, "Invalid pattern file: %s (%s)\n", optarg, patfile_get_error());
+                    return 1;
+                }
+                pattern = INITPATTERN_FILE;
+                break;
+            }
+
+            case 'o':
+            {
+                out_path = optarg;
+                break;
+            }
+
+            case 'p':
+            {
+                pattern = INITPATTERN_MAX;
+                for(int i=0; i<INITPATTERN_CYCLEMAX; i++)
+                {
+                    if(strcmp(optarg, grid_get_initpattern_short_str(i)) == 0)
+                        pattern = i;
+                }
+                if(pattern == INITPATTERN_MAX)
+                {
+                    fprintf(stderr, "Invalid pattern value: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+
+            case 'S':
+            {
+                uint32_t seed;
+                if(!batch_parse_uint(optarg, 0, UINT32_MAX, &seed))
+                {
+                    fprintf(stderr, "Invalid seed value: %s\n", optarg);
+                    return 1;
+                }
+                srandom(seed);
+                break;
+            }
+
+            case 's':
+            {
+                if(    (sscanf(optarg, "%ux%u", &width, &height) != 2)
+                    || (width  < 3) || (width  > GRID_WIDTH_MAX)
+                    || (height < 3) || (height > GRID_HEIGHT_MAX)
+                  )
+                {
+                    fprintf(stderr, "Invalid size value: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+
+            case 't':
+            {
+                stats_path = optarg;
+                break;
+            }
+
+            case 'w':
+            {
+                int val = atoi(optarg);
+                if((val < 50) || (val > END_DET_WINDOW_MAX))
+                {
+                    fprintf(stderr, "Invalid window value: %s\n", optarg);
+                    return 1;
+                }
+                window = val;
+                break;
+            }
+
+            case '?': // getopt_long() already printed an error message
+            default:
+            {
+                return 1;
+            }
+        }
+    }
+    if(optind < argc)
+    {
+        fprintf(stderr, "ncgol run: unrecognized argument \'%s\'\n", argv[optind]);
+        return 1;
+    }
+
+    if(width / shards < SHARD_WIDTH_MIN)
+    {
+        fprintf(stderr, "Grid too small for %u shards (at least %u columns per shard)\n", shards, SHARD_WIDTH_MIN);
+        return 1;
+    }
+
+    if(stats_path != NULL)
+    {
+        stats_file = (strcmp(stats_path, "-") == 0 ? stdout : fopen(stats_path, "w"));
+        if(stats_file == NULL)
+        {
+            fprintf(stderr, "Statistics file %s can not be opened\n", stats_path);
+            return 1;
+        }
+    }
+
+    // Initialize the pattern
+    start_ms = timing_now_ms();
+    history_set_enabled(0);
+    grid_set_size(width, height);
+    grid_set_window(window);
+    grid_init(pattern);
+    batch_write_stats();
+
+    // Calculate with worker processes
+    if(shards > 1)
+    {
+        shard_stats_t stats;
+
+        if(!shard_run((grid_t *)grid_get(), width, height, shards, gens, window, (stats_file != NULL ? interval : 0), batch_print_stats, &stats))
+        {
+            fprintf(stderr, "Calculation with %u shards failed\n", shards);
+            return 1;
+        }
+        batch_print_stats(&stats);
+        return batch_finish(out_path, stats_path, stats.generation);
+    }
+
+    // Calculate up to the next statistics line, the last generation or the end
+    while(1)
+    {
+        uint32_t gen  = grid_get_generation();
+        uint32_t stop = (gens > 0 ? gens : UINT32_MAX);
+
+        if((gens > 0 ? (gen >= gens) : grid_end_detected()))
+        {
+            break;
+        }
+        if((stats_file != NULL) && (interval > 0) && ((gen / interval + 1) * (uint64_t)interval < stop))
+        {
+            stop = (gen / interval + 1) * interval;
+        }
+        grid_update_n(stop - gen, UINT64_MAX);
+
+        gen = grid_get_generation();
+        if((interval > 0) && ((gen % interval) == 0) && ((gens > 0 ? (gen < gens) : !grid_end_detected())))
+        {
+            batch_write_stats();
+        }
+    }
+    batch_write_stats();
+    return batch_finish(out_path, stats_path, grid_get_generation());
+}
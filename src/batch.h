@@ -0,0 +1,20 @@
+
+// File:    batch.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Headless batch mode for scripted runs ("ncgol run ...")
+
+#ifndef __BATCH_H
+#define __BATCH_H
+
+#include <stdint.h>
+
+
+
+// Run a simulation without terminal output with the arguments after "run"
+// -> Returns the exit code of the program
+int batch_main(int argc, char * argv[]);
+
+
+
+#endif // __BATCH_H
@@ -0,0 +1,186 @@
+
+// File:    cycle_cache.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Cache for the frames of a periodic grid after the end detection.
+//          After the end detection has fired, every generation is captured until a generation
+//          is exactly equal to the first captured one. Then the period is known and the frames
+//          are replayed from memory (with their count of living cells and hash) instead of
+//          calculating them again.
+//          If the cycle does not fit into CYCLE_CACHE_MEM_MAX, the capturing is given up
+//          and the grid is calculated as before.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "cycle_cache.h"
+#include "debug_output.h"
+
+#define CYCLE_CACHE_MEM_MAX (64*1024*1024) // Memory for the captured frames in bytes
+
+typedef enum
+{
+    CACHE_CAPTURING, // Capturing the frames until the first one repeats
+    CACHE_COMPLETE,  // Cycle is complete and can be replayed
+    CACHE_FAILED     // Cycle is too long for the memory limit
+} cache_state_t;
+
+static cache_state_t state = CACHE_CAPTURING;
+static uint8_t  **cache_frames = NULL; // Captured frames (width*height bytes each, column by column)
+static uint32_t *cache_alive   = NULL; // Count of living cells for every frame
+static uint64_t *cache_hash    = NULL; // Hash for every frame
+static uint32_t frames_cnt = 0;
+static uint32_t frames_max = 0;
+static uint32_t phase      = 0;        // Frame which has been replayed last
+static uint16_t cache_width;
+static uint16_t cache_height;
+
+
+
+// Function to reset the cycle cache (frees the captured frames)
+void cycle_cache_reset(void)
+{
+    for(uint32_t i=0; i<frames_cnt; i++)
+        free(cache_frames[i]);
+    free(cache_frames);
+    free(cache_alive);
+    free(cache_hash);
+    cache_frames = NULL;
+    cache_alive  = NULL;
+    cache_hash   = NULL;
+    frames_cnt   = 0;
+    frames_max   = 0;
+    phase        = 0;
+    state        = CACHE_CAPTURING;
+}
+
+
+
+// Function to compare a grid with a captured frame
+static uint8_t cycle_cache_equal(grid_t * grid, const uint8_t * frame)
+{
+    for(uint16_t x=0; x<cache_width; x++)
+    {
+        if(memcmp(grid[x], &frame[(uint32_t)x * cache_height], cache_height) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+
+
+// Function to give up capturing
+static void cycle_cache_fail(void)
+{
+    cycle_cache_reset();
+    state = CACHE_FAILED;
+}
+
+
+
+// Function to capture the next generation of a periodic grid
+// -> Returns "1" if the cycle is complete (the generation equals the first captured one)
+uint8_t cycle_cache_capture(grid_t * grid, uint16_t width, uint16_t height, uint32_t alive, uint64_t hash)
+{
+    uint32_t frame_size = (uint32_t)width * height;
+
+    if(state != CACHE_CAPTURING)
+    {
+        return (state == CACHE_COMPLETE);
+    }
+
+    if(frames_cnt == 0)
+    {
+        // First frame -> Set up the memory for the frames
+        cache_width  = width;
+        cache_height = height;
+        frames_max   = (frame_size > 0 ? CYCLE_CACHE_MEM_MAX / frame_size : 0);
+        if(frames_max == 0)
+        {
+            cycle_cache_fail();
+            return 0;
+        }
+        cache_frames = malloc(frames_max * sizeof(cache_frames[0]));
+        cache_alive  = malloc(frames_max * sizeof(cache_alive[0]));
+        cache_hash   = malloc(frames_max * sizeof(cache_hash[0]));
+        if((cache_frames == NULL) || (cache_alive == NULL) || (cache_hash == NULL))
+        {
+            cycle_cache_fail();
+            return 0;
+        }
+    }
+    else if((width != cache_width) || (height != cache_height))
+    {
+        cycle_cache_fail();
+        return 0;
+    }
+    else if((alive == cache_alive[0]) && (hash == cache_hash[0]) && cycle_cache_equal(grid, cache_frames[0]))
+    {
+        // First frame repeats -> Period found
+        state = CACHE_COMPLETE;
+        phase = 0;
+        #if (WITH_DEBUG_OUTPUT)
+            debug_printf("Cycle captured with period %u\n", frames_cnt);
+        #endif
+        return 1;
+    }
+
+    if(frames_cnt >= frames_max)
+    {
+        #if (WITH_DEBUG_OUTPUT)
+            debug_printf("Cycle longer than %u frames, capturing stopped\n", frames_max);
+        #endif
+        cycle_cache_fail();
+        return 0;
+    }
+
+    uint8_t *frame = malloc(frame_size);
+    if(frame == NULL)
+    {
+        cycle_cache_fail();
+        return 0;
+    }
+    for(uint16_t x=0; x<width; x++)
+        memcpy(&frame[(uint32_t)x * height], grid[x], height);
+    cache_frames[frames_cnt] = frame;
+    cache_alive[frames_cnt]  = alive;
+    cache_hash[frames_cnt]   = hash;
+    frames_cnt++;
+    return 0;
+}
+
+
+
+// Return "1" if the cycle has been captured completely and can be replayed
+uint8_t cycle_cache_complete(void)
+{
+    return (state == CACHE_COMPLETE);
+}
+
+
+
+// Function to replay the frame "steps" generations after the last one into "grid"
+// -> Returns the count of living cells of this frame, its hash is written to "hash"
+uint32_t cycle_cache_replay(grid_t * grid, uint32_t steps, uint64_t * hash)
+{
+    if(state != CACHE_COMPLETE)
+    {
+        return 0;
+    }
+
+    phase = (uint32_t)(((uint64_t)phase + steps) % frames_cnt);
+    const uint8_t *frame = cache_frames[phase];
+    for(uint16_t x=0; x<cache_width; x++)
+        memcpy(grid[x], &frame[(uint32_t)x * cache_height], cache_height);
+    *hash = cache_hash[phase];
+    return cache_alive[phase];
+}
+
+
+
+// Return the period of the captured cycle (0: Not complete)
+uint32_t cycle_cache_get_period(void)
+{
+    return (state == CACHE_COMPLETE ? frames_cnt : 0);
+}
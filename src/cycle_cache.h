@@ -0,0 +1,34 @@
+
+// File:    cycle_cache.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Cache for the frames of a periodic grid after the end detection
+
+#ifndef __CYCLE_CACHE_H
+#define __CYCLE_CACHE_H
+
+#include <stdint.h>
+#include "grid.h"
+
+
+
+// Function to reset the cycle cache (frees the captured frames)
+void cycle_cache_reset(void);
+
+// Function to capture the next generation of a periodic grid
+// -> Returns "1" if the cycle is complete (the generation equals the first captured one)
+uint8_t cycle_cache_capture(grid_t * grid, uint16_t width, uint16_t height, uint32_t alive, uint64_t hash);
+
+// Return "1" if the cycle has been captured completely and can be replayed
+uint8_t cycle_cache_complete(void);
+
+// Function to replay the frame "steps" generations after the last one into "grid"
+// -> Returns the count of living cells of this frame, its hash is written to "hash"
+uint32_t cycle_cache_replay(grid_t * grid, uint32_t steps, uint64_t * hash);
+
+// Return the period of the captured cycle (0: Not complete)
+uint32_t cycle_cache_get_period(void);
+
+
+
+#endif // __CYCLE_CACHE_H
@@ -14,7 +14,7 @@
 #if (WITH_DEBUG_OUTPUT)
 
 static FILE *debug_file;
-static uint32_t debug_time[DEBUG_TIME_MAX][2] = {{0,0}};
+static uint64_t debug_time[DEBUG_TIME_MAX][2] = {{0,0}}; // Monotonic time in microseconds
 
 
 
@@ -52,8 +52,8 @@ void debug_time_start(uint8_t num)
     if(num < DEBUG_TIME_MAX)
     {
         struct timespec ts;
-        clock_gettime(CLOCK_REALTIME, &ts);
-        debug_time[num][0] = ts.tv_nsec / 1000;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        debug_time[num][0] = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
     }
 }
 
@@ -63,8 +63,8 @@ void debug_time_stop(uint8_t num)
     if(num < DEBUG_TIME_MAX)
     {
         struct timespec ts;
-        clock_gettime(CLOCK_REALTIME, &ts);
-        debug_time[num][1] = ts.tv_nsec / 1000;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        debug_time[num][1] = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
     }
 }
 
@@ -73,7 +73,7 @@ uint32_t debug_time_get(uint8_t num)
 {
     if(num < DEBUG_TIME_MAX)
     {
-        return ((debug_time[num][1] - debug_time[num][0] + 1000000) % 1000000);
+        return (debug_time[num][1] - debug_time[num][0]);
     }
     else
     {
@@ -1,98 +1,350 @@
 
-// File:    patterns.c
+// File:    end_det.c
 // Author:  Martin Ochs
 // License: MIT
 // Brief:   Implementation of the end detection functions for the Game of Life.
-//          For every cycle the number of alive cells is stored in a ring buffer.
+//          For every cycle the number of alive cells is stored in a ring buffer and the hash of
+//          the grid is stored in a hash table.
 //          The simulation is finished, in a stale or looping state under the following conditions:
 //          - The number of alive cells is zero
-//          - The number of alive cells is constant
-//          - There is a repeating pattern of variable length 'sequence' in the ring buffer
+//          - The hash of the grid has been seen before (exact, with the true period and phase)
+//          The number of alive cells alone is not enough (e.g. a glider has always 5 cells),
+//          it only selects a candidate: If the number of alive cells is constant or there is a
+//          repeating pattern of variable length 'sequence' in the last 'window' cycles, the hash
+//          of the grid is kept as candidate. The end is detected when the candidate is seen again.
+//          The candidate is replaced by the current hash after 1, 2, 4, 8, ... cycles (Brent), so
+//          a periodic state is found even if the candidate has been taken before it.
+//          The repeating pattern is found incrementally with the prefix function (Knuth-Morris-Pratt):
+//          For a sequence starting at 's0' the prefix function gives the shortest period of the
+//          sequence with constant amortized costs for every new cycle. As the window slides, some
+//          instances are started staggered by 1/8 of the window. So there is always one
+//          instance which covers at least the whole window.
+//          The candidate is still needed for patterns with a very long period (e.g. spaceships on
+//          a big grid), which are already replaced in the hash table when they repeat.
+//          All state is kept in an end_det_t (also the window), so every simulation can have its own
+//          end detection.
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include "config.h"
 #include "end_det.h"
 #include "debug_output.h"
 
-#define END_DET_CNT_MAX 500
-#define END_DET_CNT_MIN  50
-static uint16_t end_det[END_DET_CNT_MAX]; // Ring-buffer for storing the alive count for every cycle
-static uint16_t end_det_pos  = 0;
-static uint16_t ring_length = 0;
-static uint8_t  end_detected = 0;
-static uint32_t end_det_cycles = 0;
+#define END_DET_CNT_MIN    50
+#define END_DET_INSTANCES   9 // Instances of the prefix function, started every window/8 cycles
+#define END_DET_HASH_MIN 1024 // Minimum size of the hash table (power of 2)
 
+typedef struct
+{
+    uint8_t  active;
+    uint32_t s0;   // Cycle of the first value of the sequence
+    uint32_t n;    // Length of the sequence
+    uint32_t *pi;  // Prefix function of the sequence
+} end_det_inst_t;
+
+// Hash table with the cycle of every seen grid hash (direct mapped, newer entries replace older ones)
+typedef struct
+{
+    uint64_t hash;
+    uint32_t cycle; // Cycle + 1 (0: Empty)
+} end_det_hash_t;
+
+// State of one end detection (see end_det_create())
+struct end_det_s
+{
+    uint32_t       window;         // Cycles which have to repeat (see end_det_ctx_set_window())
+    uint8_t        debug;          // Debug output of the detected ends (see end_det_ctx_set_debug())
+    uint32_t       stagger;        // Cycles between the start of two instances
+    uint32_t       ring_size;      // Length of the ring buffer (= lifetime of one instance)
+    uint32_t       *ring;          // Ring-buffer for storing the alive count for every cycle
+    end_det_inst_t inst[END_DET_INSTANCES];
+    end_det_hash_t *hash_table;
+    uint32_t       hash_mask;
+    uint32_t       period;
+    uint32_t       phase;
+    uint32_t       ring_length;
+    uint8_t        end_detected;
+    uint32_t       cycles;
+    uint8_t        cand_active;    // Candidate of the end state has been selected with the number of alive cells
+    uint64_t       cand_hash;      // Hash of the candidate
+    uint32_t       cand_cycle;     // Cycle of the candidate
+    uint32_t       cand_limit;     // Cycles after which the candidate is replaced (doubled every time)
+};
+
+// Function to look up a hash and store it for the given cycle
+// -> Returns the cycle + 1 in which the hash has been seen before (0: Not seen)
+static uint32_t end_det_hash_add(end_det_t * ed, uint64_t hash, uint32_t cycle)
+{
+    end_det_hash_t *entry = &ed->hash_table[(hash ^ (hash >> 32)) & ed->hash_mask];
+    uint32_t seen = ((entry->cycle != 0) && (entry->hash == hash) ? entry->cycle : 0);
+
+    entry->hash  = hash;
+    entry->cycle = cycle + 1;
+    return seen;
+}
 
 
-// Function to reset the end detection
-void end_det_reset(void)
+
+// Create an end detection for one simulation (use end_det_ctx_reset() before the first cycle)
+// -> Returns NULL if the memory could not be allocated
+end_det_t * end_det_create(void)
 {
-    end_det_pos    = 0;
-    end_det_cycles = 0;
-    end_detected   = 0;
+    end_det_t *ed = calloc(1, sizeof(end_det_t));
+
+    if(ed != NULL)
+    {
+        ed->window = END_DET_WINDOW_DEFAULT;
+    }
+    return ed;
+}
+
+
+
+// Free an end detection of end_det_create()
+void end_det_destroy(end_det_t * ed)
+{
+    if(ed == NULL)
+    {
+        return;
+    }
+    for(uint8_t i=0; i<END_DET_INSTANCES; i++)
+        free(ed->inst[i].pi);
+    free(ed->ring);
+    free(ed->hash_table);
+    free(ed);
+}
+
 
-    memset(end_det, 0, sizeof(end_det));
+
+// Function to set the number of cycles which have to repeat for an end detection (used with the next reset)
+void end_det_ctx_set_window(end_det_t * ed, uint32_t window)
+{
+    if(window < END_DET_CNT_MIN)    window = END_DET_CNT_MIN;
+    if(window > END_DET_WINDOW_MAX) window = END_DET_WINDOW_MAX;
+    ed->window = window;
 }
 
 
 
-// Function to detect the end of the simulation
-void end_det_handle(uint32_t alive)
+// Function to enable the debug output of an end detection (see debug_output.c)
+void end_det_ctx_set_debug(end_det_t * ed, uint8_t debug)
 {
-    uint16_t testlength = 0;
+    ed->debug = debug;
+}
 
-    end_det_cycles++;
-    end_det[end_det_pos] = alive;
-    end_det_pos++;
-    end_det_pos %= END_DET_CNT_MAX;
 
-    if(end_detected)
+
+// Function to reset an end detection ("hash" of the initial grid)
+void end_det_ctx_reset(end_det_t * ed, uint64_t hash)
+{
+    ed->stagger = ed->window / (END_DET_INSTANCES - 1);
+
+    // Allocate buffers for a new window size
+    if(ed->ring_size != ed->stagger * END_DET_INSTANCES)
+    {
+        ed->ring_size = ed->stagger * END_DET_INSTANCES;
+        ed->ring      = realloc(ed->ring, ed->ring_size * sizeof(ed->ring[0]));
+        if(ed->ring == NULL)
+        {
+            exit(1);
+        }
+        for(uint8_t i=0; i<END_DET_INSTANCES; i++)
+        {
+            ed->inst[i].pi = realloc(ed->inst[i].pi, ed->ring_size * sizeof(ed->inst[i].pi[0]));
+            if(ed->inst[i].pi == NULL)
+            {
+                exit(1);
+            }
+        }
+
+        uint32_t hash_size = END_DET_HASH_MIN;
+        while(hash_size < 4 * ed->ring_size)
+            hash_size *= 2;
+        ed->hash_mask  = hash_size - 1;
+        free(ed->hash_table);
+        ed->hash_table = malloc(hash_size * sizeof(ed->hash_table[0]));
+        if(ed->hash_table == NULL)
+        {
+            exit(1);
+        }
+    }
+    memset(ed->hash_table, 0, (ed->hash_mask + 1) * sizeof(ed->hash_table[0]));
+
+    for(uint8_t i=0; i<END_DET_INSTANCES; i++)
+        ed->inst[i].active = 0;
+    ed->cycles       = 0;
+    ed->end_detected = 0;
+    ed->ring_length  = 0;
+    ed->period       = 0;
+    ed->phase        = 0;
+    ed->cand_active  = 0;
+    end_det_hash_add(ed, hash, 0);
+}
+
+
+
+// Function to add the next value to the sequence of an instance (online prefix function)
+// -> Returns the shortest period of the sequence
+static uint32_t end_det_inst_add(const end_det_t * ed, end_det_inst_t *in, uint32_t alive)
+{
+    uint32_t k = 0;
+
+    if(in->n > 0)
+    {
+        k = in->pi[in->n - 1];
+        while((k > 0) && (ed->ring[(in->s0 + k) % ed->ring_size] != alive))
+            k = in->pi[k - 1];
+        if(ed->ring[(in->s0 + k) % ed->ring_size] == alive)
+            k++;
+    }
+    in->pi[in->n] = k;
+    in->n++;
+    return in->n - k;
+}
+
+
+
+// Function to detect the end of a simulation ("hash" of the grid)
+void end_det_ctx_handle(end_det_t * ed, uint32_t alive, uint64_t hash)
+{
+    uint32_t cycle = ed->cycles;
+    uint32_t seen;
+
+    ed->cycles++;
+
+    if(ed->end_detected)
     {
         // Do nothing
         return;
     }
     else if(alive == 0)
     {
-        end_detected = 1;
-        ring_length = 0;
+        ed->end_detected = 1;
+        ed->ring_length  = 0;
+        ed->period       = 1;
+        ed->phase        = ed->cycles;
+        return;
     }
-    else if(end_det_cycles >= END_DET_CNT_MIN)                                              // At least END_DET_CNT_MIN cycles needed for detection
+    else if((seen = end_det_hash_add(ed, hash, ed->cycles)) != 0)                          // Grid has been seen before
     {
-        ring_length = (end_det_cycles<END_DET_CNT_MAX ? end_det_cycles : END_DET_CNT_MAX);  // Current length of the ring buffer
-        for(uint16_t sequence=1; sequence<=(ring_length/2); sequence++)                     // Test sequence in the length of 1 to half of the buffer
+        ed->end_detected = 1;
+        ed->phase        = seen - 1;
+        ed->period       = ed->cycles - ed->phase;
+        ed->ring_length  = ed->period;
+        #if (WITH_DEBUG_OUTPUT)
+            if(ed->debug)
+                debug_printf("End detected after %u cycles with period %u (phase %u)\n", ed->cycles, ed->period, ed->phase);
+        #endif
+        return;
+    }
+
+    else if(ed->cand_active)                                                                // Wait for the candidate
+    {
+        if(hash == ed->cand_hash)
         {
-            if(end_detected)
-                break;
-            for(uint16_t testpos=sequence; testpos<ring_length; testpos++)
-            {
-                #define RING_POS(pos) ((end_det_pos + pos) % ring_length)
-                if(end_det[RING_POS(testpos)] != end_det[RING_POS(testpos % sequence)])     // Pattern not found? -> End loop and test next sequence
-                    break;
-                if(testpos == ring_length - 1)                                              // End of loop reached? -> Pattern found!
-                {
-                    end_detected = 1;
-                    #if (WITH_DEBUG_OUTPUT)
-                        debug_printf("End detected after %u cycles with sequence length %u\n", end_det_cycles, sequence);
-                    #endif
-                }
-            }
+            ed->end_detected = 1;
+            ed->phase        = ed->cand_cycle;
+            ed->period       = ed->cycles - ed->phase;
+            ed->ring_length  = ed->period;
+            #if (WITH_DEBUG_OUTPUT)
+                if(ed->debug)
+                    debug_printf("End detected after %u cycles with period %u (candidate)\n", ed->cycles, ed->period);
+            #endif
         }
+        else if(ed->cycles - ed->cand_cycle >= ed->cand_limit)
+        {
+            ed->cand_hash   = hash;
+            ed->cand_cycle  = ed->cycles;
+            ed->cand_limit *= 2;
+        }
+        return;
     }
+
+    ed->ring[cycle % ed->ring_size] = alive;
+
+    // Start a new instance every 1/8 of the window (replaces the oldest one)
+    if((cycle % ed->stagger) == 0)
+    {
+        end_det_inst_t *in = &ed->inst[(cycle / ed->stagger) % END_DET_INSTANCES];
+        in->active = 1;
+        in->s0     = cycle;
+        in->n      = 0;
+    }
+
+    for(uint8_t i=0; i<END_DET_INSTANCES; i++)
+    {
+        end_det_inst_t *in = &ed->inst[i];
+        if(!in->active)
+            continue;
+
+        uint32_t sequence = end_det_inst_add(ed, in, alive);
+        if(    (sequence <= (in->n / 2))                                                    // Sequence repeats at least once
+            && (    (in->n >= ed->window)                                                   // Over the whole window
+                || ((in->s0 == 0) && (in->n >= END_DET_CNT_MIN))                            // Or since the beginning (at least END_DET_CNT_MIN cycles)
+               )
+          )
+        {
+            // Only a candidate, the end is detected when this grid is seen again
+            ed->cand_active = 1;
+            ed->cand_hash   = hash;
+            ed->cand_cycle  = ed->cycles;
+            ed->cand_limit  = sequence;
+            #if (WITH_DEBUG_OUTPUT)
+                if(ed->debug)
+                    debug_printf("End candidate after %u cycles with sequence length %u\n", ed->cycles, sequence);
+            #endif
+            break;
+        }
+    }
+}
+
+
+
+// Return if the end of a simulation has been detected
+uint8_t end_det_ctx_detected(const end_det_t * ed)
+{
+    return ed->end_detected;
+}
+
+
+
+// Return number of cycles since beginning of the end detection of a simulation
+uint32_t end_det_ctx_get_detection_cycles(const end_det_t * ed)
+{
+    return ed->ring_length;
+}
+
+
+
+// Return the exact period of the end state of a simulation (0: Not detected)
+uint32_t end_det_ctx_get_period(const end_det_t * ed)
+{
+    return ed->period;
 }
 
 
 
-// Return if end of simulation has been detected
-uint8_t end_det_detected(void)
+// Get the state of an end detection
+void end_det_ctx_get_state(const end_det_t * ed, end_det_state_t * state)
 {
-    return end_detected;
+    state->cycles           = ed->cycles;
+    state->detection_cycles = ed->ring_length;
+    state->period           = ed->period;
+    state->phase            = ed->phase;
+    state->detected         = ed->end_detected;
 }
 
 
 
-// Return number of cycles since beginning of the end detection
-uint32_t end_det_get_detection_cycles(void)
+// Set the state of an end detection after end_det_ctx_reset() ("hash" of the current grid)
+// -> The detection of repeating sequences starts again from this cycle
+void end_det_ctx_set_state(end_det_t * ed, const end_det_state_t * state, uint64_t hash)
 {
-    return ring_length;
+    ed->cycles       = state->cycles;
+    ed->ring_length  = state->detection_cycles;
+    ed->period       = state->period;
+    ed->phase        = state->phase;
+    ed->end_detected = state->detected;
+    end_det_hash_add(ed, hash, ed->cycles);
 }
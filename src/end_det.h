@@ -9,19 +9,60 @@
 
 #include <stdint.h>
 
+#define END_DET_WINDOW_DEFAULT   500 // Cycles which have to repeat for the end detection
+#define END_DET_WINDOW_MAX    100000
 
 
-// Function to detect the end of the simulation
-void end_det_handle(uint32_t alive);
 
-// Function to reset the end detection
-void end_det_reset(void);
+// State of the end detection for a snapshot (without the history of the cycles)
+typedef struct
+{
+    uint32_t cycles;           // Handled cycles since the reset
+    uint32_t detection_cycles; // See end_det_ctx_get_detection_cycles()
+    uint32_t period;
+    uint32_t phase;
+    uint8_t  detected;
+} end_det_state_t;
 
-// Return "1" if end of simulation has been detected
-uint8_t end_det_detected(void);
+// End detection of one simulation (see end_det_create())
+typedef struct end_det_s end_det_t;
 
-// Return number of cycles since beginning of the end detection
-uint32_t end_det_get_detection_cycles(void);
+
+
+// Create an end detection for one simulation (use end_det_ctx_reset() before the first cycle)
+// -> Returns NULL if the memory could not be allocated
+end_det_t * end_det_create(void);
+
+// Free an end detection of end_det_create()
+void end_det_destroy(end_det_t * ed);
+
+// Function to set the number of cycles which have to repeat for an end detection (used with the next reset)
+void end_det_ctx_set_window(end_det_t * ed, uint32_t window);
+
+// Function to enable the debug output of an end detection (see debug_output.c)
+void end_det_ctx_set_debug(end_det_t * ed, uint8_t debug);
+
+// Function to reset an end detection ("hash" of the initial grid)
+void end_det_ctx_reset(end_det_t * ed, uint64_t hash);
+
+// Function to detect the end of a simulation ("hash" of the grid)
+void end_det_ctx_handle(end_det_t * ed, uint32_t alive, uint64_t hash);
+
+// Return "1" if the end of a simulation has been detected
+uint8_t end_det_ctx_detected(const end_det_t * ed);
+
+// Return number of cycles since beginning of the end detection of a simulation
+uint32_t end_det_ctx_get_detection_cycles(const end_det_t * ed);
+
+// Return the exact period of the end state of a simulation (0: Not detected)
+uint32_t end_det_ctx_get_period(const end_det_t * ed);
+
+// Get the state of an end detection
+void end_det_ctx_get_state(const end_det_t * ed, end_det_state_t * state);
+
+// Set the state of an end detection after end_det_ctx_reset() ("hash" of the current grid)
+// -> The detection of repeating sequences starts again from this cycle
+void end_det_ctx_set_state(end_det_t * ed, const end_det_state_t * state, uint64_t hash);
 
 
 
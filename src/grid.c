@@ -2,7 +2,11 @@
 // File:    grid.c
 // Author:  Martin Ochs
 // License: MIT
-// Brief:   Implementation of the grid functions for the Game of Life
+// Brief:   Implementation of the grid functions for the Game of Life.
+//          The grid is one simulation of life.c on the frames of the grid: The threads calculate
+//          the columns of a generation with life_calc_part() and the last one takes it with
+//          life_next(), so the generations, the cycle counter and the end detection are the same
+//          as for every other simulation.
 //
 // Rules:   https://en.wikipedia.org/wiki/Conway%27s_Game_of_Life
 
@@ -11,18 +15,64 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <stdatomic.h>
 #include "config.h"
 #include "grid.h"
+#include "life.h"
 #include "patterns.h"
+#include "patfile.h"
+#include "snapshot.h"
+#include "replay.h"
+#include "search.h"
+#include "shm_out.h"
+#include "stream.h"
 #include "end_det.h"
+#include "cycle_cache.h"
+#include "recorder.h"
+#include "history.h"
+#include "timing.h"
 
 // Create the grid to represent the cells
-static uint8_t  grid[GRID_WIDTH_MAX][GRID_HEIGHT_MAX];
-static uint8_t  grid_new[GRID_WIDTH_MAX][GRID_HEIGHT_MAX];
-static uint32_t cells_alive = 0;
-static uint32_t cycle_counter = 0;
+// -> Three frames are used for a lock-free handoff to the drawing (triple buffering):
+//    - frame_cur:    Current generation (published, read by the simulation and maybe the drawing)
+//    - frame_back:   Next generation (only written by the simulation)
+//    - frame_latest: Newest published frame, which has not been taken by the drawing yet
+//    - frame_draw:   Frame which is currently drawn
+//    The simulation never writes into a frame which can be drawn and never waits for the drawing.
+//    The frames can also be placed into shared memory (see grid_set_frames()).
+static grid_frame_t frames_mem[3];
+static grid_frame_t *frames = frames_mem;
+#define FRAME_FRESH 0x04 // Flag in frame_latest: Frame has not been taken by the drawing yet
+static uint8_t      frame_cur  = 0;
+static uint8_t      frame_back = 1;
+static uint8_t      frame_draw = 2;
+static _Atomic uint8_t frame_latest = 0 | FRAME_FRESH;
+static grid_t       *grid     = frames_mem[0].cells; // Current generation
+static grid_t       *grid_new = frames_mem[1].cells; // Next generation
+static life_t       *life     = NULL;                // Simulation on grid and grid_new (see grid_create_life())
 static uint16_t grid_width;
 static uint16_t grid_height;
+static uint16_t cpu_cores_max = 0; // Limit of the cpu cores (0: all)
+static uint8_t  grid_quiet    = 0; // Generations are only calculated and drawn, not recorded, streamed or kept (settling, turbo)
+
+#define GRID_REMOTE_WAIT_MS 20 // Longest wait for a generation of a server (commands are handled in between)
+
+
+
+// Function to create the simulation of the grid with its first use
+static void grid_create_life(void)
+{
+    if(life != NULL)
+    {
+        return;
+    }
+    life = life_create_on(grid_width, grid_height, GRID_HEIGHT_MAX, (uint8_t *)grid, (uint8_t *)grid_new);
+    if(life == NULL)
+    {
+        exit(1);
+    }
+    life_set_debug(life, 1);
+}
 
 
 
@@ -35,6 +85,17 @@ void grid_set_size(uint16_t width, uint16_t height)
 
     grid_width  = width;
     grid_height = height;
+    grid_create_life();
+    life_set_size(life, width, height);
+}
+
+
+
+// Function to set the number of cycles which have to repeat for the end detection (used with the next grid_init())
+void grid_set_window(uint32_t window)
+{
+    grid_create_life();
+    life_set_window(life, window);
 }
 
 
@@ -55,6 +116,60 @@ uint16_t grid_get_height(void)
 
 
 
+// Function to publish the next generation (frame_back) for the drawing, the recording and the history
+static void grid_publish(void)
+{
+    grid_frame_t *frame      = &frames[frame_back];
+    uint32_t     generation = life_get_generation(life);
+
+    if(!grid_quiet)
+    {
+        recorder_add(frame->cells, grid_width, grid_height, generation);
+        stream_add(frame->cells, grid_width, grid_height, generation);
+        if(!replay_is_open() && !stream_is_remote())
+            history_add(frame->cells, grid_width, grid_height, generation);
+    }
+
+    frame->width         = grid_width;
+    frame->height        = grid_height;
+    frame->cells_alive   = life_get_cells_alive(life);
+    frame->end_detected  = life_end_detected(life);
+    frame->period        = life_get_period(life);
+    frame->cycle_counter = life_get_cycle_counter(life);
+
+    frame_cur  = frame_back;
+    frame_back = atomic_exchange(&frame_latest, frame_cur | FRAME_FRESH) & 0x03;
+    grid       = frames[frame_cur].cells;
+    grid_new   = frames[frame_back].cells;
+    life_set_cells(life, (uint8_t *)grid, (uint8_t *)grid_new);
+    shm_out_publish(frame_cur, generation, frame_back);
+}
+
+
+
+// Function to start the simulation again with the cells of the next generation (frame_back, see grid_publish())
+// -> "gen": Generation since the initialization, "cycles": Cycles counted up to this generation
+static void grid_load(uint32_t gen, uint32_t cycles)
+{
+    life_set_cells(life, (uint8_t *)grid_new, NULL);
+    life_load(life, gen, cycles);
+}
+
+
+
+// Place the frames of the grid into other memory (three frames, e.g. shared memory, before grid_init())
+void grid_set_frames(grid_frame_t * mem)
+{
+    frames   = mem;
+    grid     = frames[frame_cur].cells;
+    grid_new = frames[frame_back].cells;
+    grid_create_life();
+    life_set_cells(life, (uint8_t *)grid, (uint8_t *)grid_new);
+    shm_out_publish(frame_cur, life_get_generation(life), frame_back);
+}
+
+
+
 // Text  strings for the initpattern_t enum
 static const char *init_str[][2] =
 {
@@ -82,99 +197,100 @@ void grid_init(initpattern_t pattern)
     if(pattern >= INITPATTERN_MAX)
         return;
 
-    memset(grid, 0, sizeof(grid));
-    memset(grid_new, 0, sizeof(grid_new));
+    // The new pattern is set into the next generation and then published like every generation
+    // -> The current generation can still be drawn or read from the shared memory (see shm_out.c),
+    //    the next one is owned by the simulation and marked as being written
+    grid_t *cells = grid_new;
+    memset(cells, 0, sizeof(frames[0].cells));
 
     if     (pattern == INITPATTERN_RANDOM)
     {
         uint16_t x, y;
         for(x=0; x<grid_width; x++)
             for(y=0; y<grid_height; y++)
-                grid[x][y] = (random() & 0x1);
-        for(x=0; x<10; x++)
-            grid_update();
+                cells[x][y] = (random() & 0x1);
     }
     else if(pattern == INITPATTERN_CONWAY)
     {
         if((grid_get_width() >= patterns_get_width(PATTERN_CONWAY_FULL)) && (grid_get_height() >= patterns_get_height(PATTERN_CONWAY_FULL)))
         {
             // Conway's Game of Life
-            patterns_set_to_center(PATTERN_CONWAY_FULL, grid);
+            patterns_set_to_center(PATTERN_CONWAY_FULL, cells);
         }
         else
         {
             // Conway
-            patterns_set_to_center(PATTERN_CONWAY, grid);
+            patterns_set_to_center(PATTERN_CONWAY, cells);
         }
     }
     else if(pattern == INITPATTERN_STILLLIFES)
     {
         // Block
-        patterns_set_to_pos(PATTERN_BLOCK, grid, 1, 1);
+        patterns_set_to_pos(PATTERN_BLOCK, cells, 1, 1);
 
         // Beehive
-        patterns_set_to_pos(PATTERN_BEEHIVE, grid, 6, 1);
+        patterns_set_to_pos(PATTERN_BEEHIVE, cells, 6, 1);
 
         // Loaf
         if(grid_width >= 18)
-            patterns_set_to_pos(PATTERN_LOAF, grid, 13, 1);
+            patterns_set_to_pos(PATTERN_LOAF, cells, 13, 1);
 
         // Boat
         if(grid_width >= 24)
-            patterns_set_to_pos(PATTERN_BOAT, grid, 20, 1);
+            patterns_set_to_pos(PATTERN_BOAT, cells, 20, 1);
 
         // Tub
         if(grid_width >= 30)
-            patterns_set_to_pos(PATTERN_TUB, grid, 26, 1);
+            patterns_set_to_pos(PATTERN_TUB, cells, 26, 1);
     }
     else if(pattern == INITPATTERN_OSCILLATORS)
     {
         // Blinker
-        patterns_set_to_pos(PATTERN_BLINKER, grid, 1, 2);
+        patterns_set_to_pos(PATTERN_BLINKER, cells, 1, 2);
 
         // Toad
-        patterns_set_to_pos(PATTERN_TOAD, grid, 7, 2);
+        patterns_set_to_pos(PATTERN_TOAD, cells, 7, 2);
 
         // Beacon
         if(grid_width >= 18)
-            patterns_set_to_pos(PATTERN_BEACON, grid, 14, 2);
+            patterns_set_to_pos(PATTERN_BEACON, cells, 14, 2);
 
         // Pulsar
         if((grid_width >= 36) && (grid_height >= 16))
-            patterns_set_to_pos(PATTERN_PULSAR, grid, 22, 1);
+            patterns_set_to_pos(PATTERN_PULSAR, cells, 22, 1);
 
         // Penta-decathlon
         if((grid_width >= 17) && (grid_height >= 17))
-            patterns_set_to_pos(PATTERN_PENTA_DECATHLON, grid, 4, 10);
+            patterns_set_to_pos(PATTERN_PENTA_DECATHLON, cells, 4, 10);
 
         // Octagon
         if(grid_height >= 25)
-            patterns_set_to_pos(PATTERN_OCTAGON, grid, 2, 18);
+            patterns_set_to_pos(PATTERN_OCTAGON, cells, 2, 18);
 
         // Tumbler
         if((grid_width >= 21) && (grid_height >= 25))
-            patterns_set_to_pos(PATTERN_TUMBLER, grid, 11, 18);
+            patterns_set_to_pos(PATTERN_TUMBLER, cells, 11, 18);
     }
     else if(pattern == INITPATTERN_SPACESHIPS)
     {
         // Glider
-        patterns_set_to_pos(PATTERN_GLIDER, grid, 1, 1);
+        patterns_set_to_pos(PATTERN_GLIDER, cells, 1, 1);
 
         // Lightweight spaceship (LWSS)
-        patterns_set_to_pos(PATTERN_LWSS, grid, 7, 1);
+        patterns_set_to_pos(PATTERN_LWSS, cells, 7, 1);
 
         // Middleweight spaceship (MWSS)
         if(grid_height >= 14)
-            patterns_set_to_pos(PATTERN_MWSS, grid, 7, 7);
+            patterns_set_to_pos(PATTERN_MWSS, cells, 7, 7);
 
         // Heavyweight spaceship (HWSS)
         if(grid_height >= 21)
-            patterns_set_to_pos(PATTERN_HWSS, grid, 7, 14);
+            patterns_set_to_pos(PATTERN_HWSS, cells, 7, 14);
     }
     else if(pattern == INITPATTERN_GOSPER_GLIDERGUN)
     {
         // Gosper Glider gun
-        patterns_set_to_pos(PATTERN_GOSPER_GLIDERGUN, grid, 1, 1);
+        patterns_set_to_pos(PATTERN_GOSPER_GLIDERGUN, cells, 1, 1);
 
         // Glider stopper below (move it to the lower right corner)
         if((grid_width >= 38) && (grid_height >= 18))
@@ -200,7 +316,7 @@ void grid_init(initpattern_t pattern)
                 }
                 else
                 {
-                    patterns_set_to_pos(PATTERN_GLIDER_STOPPER_BELOW, grid, x, y);
+                    patterns_set_to_pos(PATTERN_GLIDER_STOPPER_BELOW, cells, x, y);
                     break;
                 }
             }
@@ -211,7 +327,7 @@ void grid_init(initpattern_t pattern)
     else if(pattern == INITPATTERN_SIMKIN_GLIDERGUN)
     {
         // Simkin Glider gun
-        patterns_set_to_center(PATTERN_SIMKIN_GLIDERGUN, grid);
+        patterns_set_to_center(PATTERN_SIMKIN_GLIDERGUN, cells);
 
         // Glider stopper below (move it to the lower right corner)
         if((grid_width >= 33) && (grid_height >= 27))
@@ -236,7 +352,7 @@ void grid_init(initpattern_t pattern)
                 }
                 else
                 {
-                    patterns_set_to_pos(PATTERN_GLIDER_STOPPER_BELOW, grid, x, y);
+                    patterns_set_to_pos(PATTERN_GLIDER_STOPPER_BELOW, cells, x, y);
                     break;
                 }
             }
@@ -267,7 +383,7 @@ void grid_init(initpattern_t pattern)
                 }
                 else
                 {
-                    patterns_set_to_pos(PATTERN_GLIDER_STOPPER_ABOVE, grid, x, y);
+                    patterns_set_to_pos(PATTERN_GLIDER_STOPPER_ABOVE, cells, x, y);
                     break;
                 }
             }
@@ -278,102 +394,223 @@ void grid_init(initpattern_t pattern)
     else if(pattern == INITPATTERN_PENTOMINO)
     {
         // Pentomino
-        patterns_set_to_center(PATTERN_PENTOMINO, grid);
+        patterns_set_to_center(PATTERN_PENTOMINO, cells);
     }
     else if(pattern == INITPATTERN_DIEHARD)
     {
         // Diehard
-        patterns_set_to_center(PATTERN_DIEHARD, grid);
+        patterns_set_to_center(PATTERN_DIEHARD, cells);
     }
     else if(pattern == INITPATTERN_ACORN)
     {
         // Acorn
-        patterns_set_to_center(PATTERN_ACORN, grid);
+        patterns_set_to_center(PATTERN_ACORN, cells);
     }
     else if(pattern == INITPATTERN_BLOCKENGINE1)
     {
         // Block engine 1
-        patterns_set_to_center(PATTERN_BLOCKENGINE1, grid);
+        patterns_set_to_center(PATTERN_BLOCKENGINE1, cells);
     }
     else if(pattern == INITPATTERN_BLOCKENGINE2)
     {
         // Block engine 2
-        patterns_set_to_center(PATTERN_BLOCKENGINE2, grid);
+        patterns_set_to_center(PATTERN_BLOCKENGINE2, cells);
     }
     else if(pattern == INITPATTERN_DOUBLEBLOCKENGINE)
     {
         // Double block engine
-        patterns_set_to_center(PATTERN_DOUBLEBLOCKENGINE, grid);
+        patterns_set_to_center(PATTERN_DOUBLEBLOCKENGINE, cells);
     }
     else if(pattern == INITPATTERN_ILOVE8BIT)
     {
         // I love 8 bit
-        patterns_set_to_center(PATTERN_ILOVE8BIT, grid);
+        patterns_set_to_center(PATTERN_ILOVE8BIT, cells);
+    }
+    else if(pattern == INITPATTERN_FILE)
+    {
+        // Pattern from file
+        patfile_set_to_center(cells);
+    }
+    else if(pattern == INITPATTERN_SNAPSHOT)
+    {
+        // Cells from snapshot (the state is restored below)
+        snapshot_set_to_grid(cells);
+    }
+    else if(pattern == INITPATTERN_REPLAY)
+    {
+        // First frame of the recording
+        replay_seek(0);
+        replay_set_to_grid(cells);
+    }
+    else if(pattern == INITPATTERN_SOUP)
+    {
+        // Soup of the search
+        search_set_to_center(cells);
+    }
+    else if(pattern == INITPATTERN_REMOTE)
+    {
+        // Newest generation from the server (if already received)
+        stream_set_to_grid(cells);
     }
     else            // INITPATTERN_CLEAR
     {
         // Do nothing
     }
 
-    cycle_counter = 0;
-    end_det_reset();
+    // Start the simulation (counts the living cells and hashes them) and publish
+    grid_load(0, 0);
+    cycle_cache_reset();
+    history_reset();
+    if(pattern == INITPATTERN_SNAPSHOT)
+    {
+        // Resume the cycle counter and the end detection (end detection only with the same grid)
+        grid_state_t    state;
+        end_det_state_t end_det_state;
+        if(snapshot_get_state(&state, &end_det_state))
+        {
+            grid_load(0, state.cycle_counter);
+            if((state.width == grid_width) && (state.height == grid_height) && (state.hash == life_get_hash(life)))
+                life_set_end_state(life, &end_det_state);
+        }
+    }
+    grid_quiet = (pattern == INITPATTERN_RANDOM); // Random cells are only recorded after they have settled down
+    grid_publish();
+
+    if(pattern == INITPATTERN_RANDOM)
+    {
+        // Let the random cells settle down and publish them again as first generation
+        for(uint8_t i=0; i<10; i++)
+            grid_update();
+        grid_quiet = 0;
+        memcpy(grid_new, grid_get(), sizeof(frames[0].cells));
+        grid_load(0, 0);
+        cycle_cache_reset();
+        grid_publish();
+    }
 }
 
 
 
 // Function to update the grid based on the game of life rules (multi-threaded with a subset of given columns for each thread)
+typedef struct calc_batch_s calc_batch_t;
+
 typedef struct
 {
-    uint16_t x_beg;
-    uint16_t x_cnt;
+    uint16_t     x_beg;
+    uint16_t     x_cnt;
+    uint32_t     alive; // Result: Count of living cells in the columns
+    uint64_t     hash;  // Result: Changes of the hash in the columns
+    calc_batch_t *batch;
 } calc_thread_arg_t;
 
+// Shared state of the threads for a batch of generations (see grid_update_n())
+struct calc_batch_s
+{
+    pthread_mutex_t   mutex;
+    pthread_cond_t    cond;
+    uint16_t          thread_cnt;
+    uint16_t          arrived;     // Threads which have finished the current generation
+    uint32_t          generation;  // Number of finished generations in this batch
+    uint32_t          gens;        // Requested generations
+    uint64_t          deadline_ns; // End of the time budget
+    uint8_t           end_detected;
+    uint8_t           quiet;       // Only the last generation of the batch is recorded, streamed and kept
+    uint8_t           stop;
+    calc_thread_arg_t *args;
+};
+
+
+
+// Thread for one generation
 void * grid_calc(void * args)
 {
-    uint16_t x, y;
-    uint16_t x_beg = ((calc_thread_arg_t*)args)->x_beg;
-    uint16_t x_cnt = ((calc_thread_arg_t*)args)->x_cnt;
+    calc_thread_arg_t *arg = (calc_thread_arg_t*)args;
+
+    arg->alive = life_calc_part(life, arg->x_beg, arg->x_cnt, &arg->hash);
+    pthread_exit(NULL);
+}
 
-    for(x=x_beg; x<(x_beg+x_cnt); x++)
+
+
+// Function to finish a generation (end detection and publish)
+// -> After the end detection the generations are captured until the cycle repeats
+static void grid_finish(uint32_t alive, uint64_t hash_diff)
+{
+    life_next(life, alive, life_get_hash(life) ^ hash_diff);
+    if(life_end_detected(life))
     {
-        for(y=0; y<grid_height; y++)
+        cycle_cache_capture(grid_new, grid_width, grid_height, life_get_cells_alive(life), life_get_hash(life));
+    }
+    grid_publish();
+}
+
+
+
+// Function to replay the generation "steps" after the current one from the cycle cache
+static void grid_replay(uint32_t steps)
+{
+    uint64_t hash  = life_get_hash(life);
+    uint32_t alive = cycle_cache_replay(grid_new, steps, &hash);
+
+    life_skip(life, steps, alive, hash);
+    grid_publish();
+}
+
+
+
+// Thread for a batch of generations
+// -> The threads stay alive for the whole batch. The last thread of every generation
+//    finishes it, the others wait for it at the barrier.
+static void * grid_calc_batch(void * args)
+{
+    calc_thread_arg_t *arg   = (calc_thread_arg_t*)args;
+    calc_batch_t      *batch = arg->batch;
+    uint8_t           stop   = 0;
+
+    while(!stop)
+    {
+        arg->alive = life_calc_part(life, arg->x_beg, arg->x_cnt, &arg->hash);
+
+        pthread_mutex_lock(&batch->mutex);
+        batch->arrived++;
+        if(batch->arrived == batch->thread_cnt)
         {
-            // Count neighbors
-            uint8_t neighbors = 0;
-            for(int8_t dx=-1; dx<=1; dx++)
+            // Last thread -> Finish this generation and release the others
+            uint32_t alive = 0;
+            uint64_t hash  = 0;
+            for(uint16_t i=0; i<batch->thread_cnt; i++)
             {
-                for(int8_t dy=-1; dy<=1; dy++)
-                {
-                    if(dx == 0 && dy == 0)
-                    {
-                        continue;
-                    }
-                    uint16_t nx = (grid_width + x + dx) % grid_width;
-                    uint16_t ny = (grid_height + y + dy) % grid_height;
-                    neighbors += grid[nx][ny];
-                }
-            }
-            // Calculate new state
-            // -> This way seems redundant (2 times the same else case), but it is more cpu efficient!
-            if(grid[x][y] == 0)
-            {
-                if(neighbors == 3)      // Reproduction
-                    grid_new[x][y] = 1;
-                else                    // Stasis
-                    grid_new[x][y] = grid[x][y];
+                alive += batch->args[i].alive;
+                hash  ^= batch->args[i].hash;
             }
-            else
+            uint8_t last  = (batch->generation + 1 >= batch->gens) || (timing_now_ns() >= batch->deadline_ns);
+            uint8_t quiet = grid_quiet;
+            grid_quiet = quiet || (batch->quiet && !last);
+            grid_finish(alive, hash);
+            grid_quiet = quiet;
+            batch->generation++;
+            batch->arrived = 0;
+
+            // Stop at the end of the batch, the time budget or a new end detection
+            if(    last
+                || (life_end_detected(life) && !batch->end_detected)
+                ||  cycle_cache_complete()
+              )
             {
-                if     (neighbors  < 2) // Underpopulation
-                    grid_new[x][y] = 0;
-                else if(neighbors  > 3) // Overpopulation
-                    grid_new[x][y] = 0;
-                else                    // Stasis
-                    grid_new[x][y] = grid[x][y];
+                batch->stop = 1;
             }
+            pthread_cond_broadcast(&batch->cond);
+        }
+        else
+        {
+            uint32_t generation = batch->generation;
+            while(generation == batch->generation)
+                pthread_cond_wait(&batch->cond, &batch->mutex);
         }
+        stop = batch->stop;
+        pthread_mutex_unlock(&batch->mutex);
     }
-    pthread_exit(NULL);
+    return NULL;
 }
 
 
@@ -381,7 +618,16 @@ void * grid_calc(void * args)
 // Return number of usable cpu cores
 uint16_t grid_get_cpu_cores(void)
 {
-    return sysconf(_SC_NPROCESSORS_ONLN); // Number of active Cores
+    uint16_t cores = sysconf(_SC_NPROCESSORS_ONLN); // Number of active Cores
+    return ((cpu_cores_max > 0) && (cpu_cores_max < cores) ? cpu_cores_max : cores);
+}
+
+
+
+// Limit the number of cpu cores for the calculation (0: all cores)
+void grid_set_cpu_cores(uint16_t cores)
+{
+    cpu_cores_max = cores;
 }
 
 
@@ -394,9 +640,11 @@ void grid_update(void)
     pthread_t threads[thread_cnt];
     calc_thread_arg_t args[thread_cnt];
 
-    if(!end_det_detected())
+    // Periodic grid has been captured -> Nothing to calculate
+    if(cycle_cache_complete())
     {
-        cycle_counter++;
+        grid_replay(1);
+        return;
     }
 
     for(int i=0; i<thread_cnt; i++)
@@ -411,60 +659,202 @@ void grid_update(void)
             exit(1);
         }
     }
+    // Count living cells
+    uint32_t l_cells_alive = 0;
+    uint64_t l_hash        = 0;
     for(int i=0; i<thread_cnt; i++)
     {
         pthread_join(threads[i], NULL);
+        l_cells_alive += args[i].alive;
+        l_hash        ^= args[i].hash;
     }
+    grid_finish(l_cells_alive, l_hash);
+}
 
-    // Count living cells
-    uint32_t l_cells_alive = 0;
-    for(uint16_t x=0; x<grid_width; x++)
+
+
+// Function to update the grid for a batch of generations (start multi-threaded calculation once)
+// -> Stops after "gens" generations, after "budget_ns" or when the end is detected
+// -> "quiet": Only the last generation is recorded, streamed and kept in the history
+// -> Returns the number of calculated generations
+static uint32_t grid_update_batch(uint32_t gens, uint64_t budget_ns, uint8_t quiet)
+{
+    uint16_t thread_cnt = grid_get_cpu_cores();
+    if(thread_cnt > grid_width) thread_cnt = grid_width;
+    if(thread_cnt < 1)          thread_cnt = 1;
+    pthread_t         threads[thread_cnt];
+    calc_thread_arg_t args[thread_cnt];
+    calc_batch_t      batch;
+
+    if(gens == 0)
+    {
+        return 0;
+    }
+
+    // Periodic grid has been captured -> Nothing to calculate, skip directly to the last generation
+    if(cycle_cache_complete())
     {
-        for(uint16_t y=0; y<grid_height; y++)
+        grid_replay(gens);
+        return gens;
+    }
+
+    pthread_mutex_init(&batch.mutex, NULL);
+    pthread_cond_init(&batch.cond, NULL);
+    batch.thread_cnt   = thread_cnt;
+    batch.arrived      = 0;
+    batch.generation   = 0;
+    batch.gens         = gens;
+    batch.deadline_ns  = (budget_ns < UINT64_MAX - timing_now_ns() ? timing_now_ns() + budget_ns : UINT64_MAX); // UINT64_MAX: No budget
+    batch.end_detected = life_end_detected(life);
+    batch.quiet        = quiet;
+    batch.stop         = 0;
+    batch.args         = args;
+
+    // The calling thread calculates the first subset of columns itself
+    for(int i=0; i<thread_cnt; i++)
+    {
+        uint16_t x_beg = ((int)grid_width * i) / thread_cnt;
+        uint16_t x_end = ((int)grid_width * (i+1)) / thread_cnt;
+        args[i].x_beg = x_beg;
+        args[i].x_cnt = x_end - x_beg;
+        args[i].batch = &batch;
+        if((i > 0) && pthread_create(&threads[i], NULL, grid_calc_batch, (void *)&args[i]))
         {
-            if(grid_new[x][y])
-                l_cells_alive++;
+            exit(1);
         }
     }
-    cells_alive = l_cells_alive;
+    grid_calc_batch(&args[0]);
+    for(int i=1; i<thread_cnt; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
 
-    memcpy(grid, grid_new, sizeof(grid));
-    end_det_handle(cells_alive);
+    pthread_mutex_destroy(&batch.mutex);
+    pthread_cond_destroy(&batch.cond);
+    return batch.generation;
 }
 
 
 
-// Get pointer to grid
-grid_t * grid_get(void)
+// Function to update the grid for a batch of generations (start multi-threaded calculation once)
+// -> Stops after "gens" generations, after "budget_ns" or when the end is detected
+// -> Returns the number of calculated generations
+uint32_t grid_update_n(uint32_t gens, uint64_t budget_ns)
 {
-    return grid;
+    return grid_update_batch(gens, budget_ns, 0);
 }
 
 
 
-// Get count of cells which are alive
-uint32_t grid_get_cells_alive(void)
+// Function to update the grid for a batch of generations like grid_update_n() (turbo levels)
+// -> Only the last generation is recorded, streamed and kept in the history, the others are only calculated
+uint32_t grid_update_turbo(uint32_t gens, uint64_t budget_ns)
 {
-    return cells_alive;
+    return grid_update_batch(gens, budget_ns, 1);
 }
 
 
 
-// Get cycle counter
-uint32_t grid_get_cycle_counter(void)
+// Function to step through a recording instead of calculating the generations (see replay_open())
+void grid_update_replay(int32_t steps)
+{
+    replay_seek((int64_t)replay_get_frame() + steps);
+    memset(grid_new, 0, sizeof(frames[0].cells));
+    replay_set_to_grid(grid_new);
+    grid_load(life_get_generation(life) + 1, replay_get_generation());
+    grid_publish();
+}
+
+
+
+// Function to show the newest generation of a server instead of calculating the generations (see stream_connect())
+// -> Waits a short time for a new generation, nothing is published without one
+void grid_update_remote(void)
 {
-    if(!end_det_detected())
+    uint32_t cycles;
+
+    if(!stream_wait(GRID_REMOTE_WAIT_MS))
     {
-        return cycle_counter;
+        return;
     }
-    else if(cycle_counter >= end_det_get_detection_cycles())
+    memset(grid_new, 0, sizeof(frames[0].cells));
+    cycles = stream_set_to_grid(grid_new);
+    grid_load(life_get_generation(life) + 1, cycles);
+    grid_publish();
+}
+
+
+
+// Function to go back a number of generations
+// -> Generations which are not kept in the history are calculated again from the nearest one
+void grid_rewind(uint32_t gens)
+{
+    uint32_t generation = life_get_generation(life);
+    uint32_t target     = (gens < generation ? generation - gens : 0);
+    uint32_t gen;
+
+    memset(grid_new, 0, sizeof(frames[0].cells));
+    gen = history_get(target, grid_new);
+    if(gen == HISTORY_NONE)
     {
-        return (cycle_counter - end_det_get_detection_cycles());
+        return;
     }
-    else
+
+    // The simulation goes on from this generation
+    grid_load(gen, gen);
+    cycle_cache_reset();
+    grid_publish();
+
+    while(life_get_generation(life) < target)
     {
-        return 0;
+        if(grid_update_n(target - life_get_generation(life), UINT64_MAX) == 0)
+            break;
+    }
+}
+
+
+
+// Get pointer to grid (current generation, only for the simulation thread)
+grid_t * grid_get(void)
+{
+    return grid;
+}
+
+
+
+// Get the newest finished generation for drawing (without copy, only for one drawing thread)
+// -> The frame stays valid until the next call
+const grid_frame_t * grid_get_frame(void)
+{
+    if(atomic_load(&frame_latest) & FRAME_FRESH)
+    {
+        frame_draw = atomic_exchange(&frame_latest, frame_draw) & 0x03;
     }
+    return &frames[frame_draw];
+}
+
+
+
+// Get count of cells which are alive
+uint32_t grid_get_cells_alive(void)
+{
+    return life_get_cells_alive(life);
+}
+
+
+
+// Get cycle counter
+uint32_t grid_get_cycle_counter(void)
+{
+    return life_get_cycle_counter(life);
+}
+
+
+
+// Get the generation since the initialization (only for the simulation thread, also after the end detection)
+uint32_t grid_get_generation(void)
+{
+    return life_get_generation(life);
 }
 
 
@@ -472,10 +862,30 @@ uint32_t grid_get_cycle_counter(void)
 // Return short text string for pattern
 const char * grid_get_initpattern_short_str(initpattern_t initpattern)
 {
-    if(initpattern < INITPATTERN_MAX)
+    if(initpattern < INITPATTERN_CYCLEMAX)
     {
         return init_str[initpattern][0];
     }
+    else if(initpattern == INITPATTERN_FILE)
+    {
+        return patfile_get_name();
+    }
+    else if(initpattern == INITPATTERN_SNAPSHOT)
+    {
+        return snapshot_get_name();
+    }
+    else if(initpattern == INITPATTERN_REPLAY)
+    {
+        return replay_get_name();
+    }
+    else if(initpattern == INITPATTERN_SOUP)
+    {
+        return "soup";
+    }
+    else if(initpattern == INITPATTERN_REMOTE)
+    {
+        return stream_get_name();
+    }
     else
     {
         return "?";
@@ -487,10 +897,30 @@ const char * grid_get_initpattern_short_str(initpattern_t initpattern)
 // Return long text string for pattern
 const char * grid_get_initpattern_long_str(initpattern_t initpattern)
 {
-    if(initpattern < INITPATTERN_MAX)
+    if(initpattern < INITPATTERN_CYCLEMAX)
     {
         return init_str[initpattern][1];
     }
+    else if(initpattern == INITPATTERN_FILE)
+    {
+        return patfile_get_name();
+    }
+    else if(initpattern == INITPATTERN_SNAPSHOT)
+    {
+        return snapshot_get_name();
+    }
+    else if(initpattern == INITPATTERN_REPLAY)
+    {
+        return replay_get_name();
+    }
+    else if(initpattern == INITPATTERN_SOUP)
+    {
+        return "soup";
+    }
+    else if(initpattern == INITPATTERN_REMOTE)
+    {
+        return stream_get_name();
+    }
     else
     {
         return "?";
@@ -502,5 +932,76 @@ const char * grid_get_initpattern_long_str(initpattern_t initpattern)
 // Return if end of simulation has been detected
 uint8_t grid_end_detected(void)
 {
-    return end_det_detected();
+    return life_end_detected(life);
+}
+
+
+
+// Return the exact period of the end state (0: Unknown)
+uint32_t grid_get_period(void)
+{
+    return life_get_period(life);
+}
+
+
+
+// Get the state of the current generation (only for the simulation thread)
+void grid_get_state(grid_state_t * state)
+{
+    state->width         = grid_width;
+    state->height        = grid_height;
+    state->cycle_counter = life_get_cycles(life);
+    state->cells_alive   = life_get_cells_alive(life);
+    state->hash          = life_get_hash(life);
+}
+
+
+
+// Get the state of the end detection of the current generation (only for the simulation thread)
+void grid_get_end_det_state(end_det_state_t * state)
+{
+    life_get_end_state(life, state);
+}
+
+
+
+// Pack a grid into bits (see GRID_PACKED_SIZE())
+// -> 8 cells are gathered at once: The multiplication moves bit 0 of every byte into the top byte
+void grid_pack(const grid_t * grid, uint16_t width, uint16_t height, uint8_t * bits)
+{
+    uint16_t col_bytes = (height + 7) / 8;
+
+    for(uint16_t x=0; x<width; x++)
+    {
+        uint8_t *col = &bits[(uint32_t)x * col_bytes];
+        for(uint16_t i=0; i<col_bytes; i++)
+        {
+            uint64_t cells = 0;
+            uint16_t cnt   = (height - i * 8 < 8 ? height - i * 8 : 8);
+            memcpy(&cells, &grid[x][i * 8], cnt);
+            col[i] = ((cells & 0x0101010101010101ull) * 0x0102040810204080ull) >> 56;
+        }
+    }
+}
+
+
+
+// Unpack bits of a grid with the given size into the center of a grid
+void grid_unpack(grid_t * grid, const uint8_t * bits, uint16_t width, uint16_t height)
+{
+    uint16_t col_bytes = (height + 7) / 8;
+    int32_t  x_off = ((int32_t)grid_width  - width)  / 2;
+    int32_t  y_off = ((int32_t)grid_height - height) / 2;
+
+    for(uint16_t x=0; x<width; x++)
+    {
+        const uint8_t *col = &bits[(uint32_t)x * col_bytes];
+        if((x + x_off < 0) || (x + x_off >= grid_width))
+            continue;
+        for(uint16_t y=0; y<height; y++)
+        {
+            if((y + y_off >= 0) && (y + y_off < grid_height))
+                grid[x + x_off][y + y_off] = (col[y / 8] >> (y % 8)) & 1;
+        }
+    }
 }
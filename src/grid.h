@@ -8,6 +8,7 @@
 #define __GRID_H
 
 #include <stdint.h>
+#include "end_det.h"
 
 // Define the size of the grid
 // Example: Fullscreen Terminal on Ultrawidescreen Monitor
@@ -60,15 +61,48 @@ typedef enum
     INITPATTERN_ILOVE8BIT,
     // ----------------
     INITPATTERN_CYCLEMAX, // Boundary for cycling through patterns
+    INITPATTERN_FILE,     // Special pattern loaded from a file (see patfile_open())
+    INITPATTERN_SNAPSHOT, // Special pattern to resume from a snapshot (see snapshot_open())
+    INITPATTERN_REPLAY,   // Special pattern to play a recording (see replay_open())
+    INITPATTERN_SOUP,     // Special pattern of the soup search (see search_set_soup())
+    INITPATTERN_REMOTE,   // Special pattern to show the generations of a server (see stream_connect())
     INITPATTERN_CLEAR,    // Special pattern to clear the grid
     INITPATTERN_MAX
 } initpattern_t;
 
+// Finished generation with its statistics (handed over from the simulation to the drawing)
+typedef struct
+{
+    grid_t   cells[GRID_WIDTH_MAX]; // Same layout as the grid: cells[x][y]
+    uint16_t width;
+    uint16_t height;
+    uint32_t cycle_counter;         // Value of grid_get_cycle_counter()
+    uint32_t cells_alive;
+    uint8_t  end_detected;
+    uint32_t period;                // Exact period of the end state (0: Unknown)
+} grid_frame_t;
+
+// State of the simulation for a snapshot
+typedef struct
+{
+    uint16_t width;
+    uint16_t height;
+    uint32_t cycle_counter; // Cycles since the initialization (also after the end detection)
+    uint32_t cells_alive;
+    uint64_t hash;
+} grid_state_t;
+
+// Bytes for a packed grid (1 bit per cell, every column starts with a new byte)
+#define GRID_PACKED_SIZE(width, height) ((uint32_t)(width) * (((height) + 7) / 8))
+
 
 
 // Function to set the grid size
 void grid_set_size(uint16_t width, uint16_t height);
 
+// Function to set the number of cycles which have to repeat for the end detection (used with the next grid_init())
+void grid_set_window(uint32_t window);
+
 // Function to get grid width
 uint16_t grid_get_width(void);
 
@@ -81,18 +115,40 @@ void grid_init(initpattern_t pattern);
 // Return number of usable cpu cores
 uint16_t grid_get_cpu_cores(void);
 
+// Limit the number of cpu cores for the calculation (0: all cores)
+void grid_set_cpu_cores(uint16_t cores);
+
 // Function to update the grid based on the game of life rules
 void grid_update(void);
 
-// Get pointer to grid
+// Function to update the grid for a batch of generations (start multi-threaded calculation once)
+// -> Stops after "gens" generations, after "budget_ns" or when the end is detected
+// -> Returns the number of calculated generations
+uint32_t grid_update_n(uint32_t gens, uint64_t budget_ns);
+
+// Function to update the grid for a batch of generations like grid_update_n() (turbo levels)
+// -> Only the last generation is recorded, streamed and kept in the history, the others are only calculated
+uint32_t grid_update_turbo(uint32_t gens, uint64_t budget_ns);
+
+// Get pointer to grid (current generation, only for the simulation thread)
 grid_t * grid_get(void);
 
+// Place the frames of the grid into other memory (three frames, e.g. shared memory, before grid_init())
+void grid_set_frames(grid_frame_t * mem);
+
+// Get the newest finished generation for drawing (without copy, only for one drawing thread)
+// -> The frame stays valid until the next call
+const grid_frame_t * grid_get_frame(void);
+
 // Get count of cells which are alive
 uint32_t grid_get_cells_alive(void);
 
 // Get cycle counter
 uint32_t grid_get_cycle_counter(void);
 
+// Get the generation since the initialization (only for the simulation thread, also after the end detection)
+uint32_t grid_get_generation(void);
+
 // Return short text string for pattern
 const char * grid_get_initpattern_short_str(initpattern_t initpattern);
 
@@ -102,6 +158,31 @@ const char * grid_get_initpattern_long_str(initpattern_t initpattern);
 // Return if end of simulation has been detected
 uint8_t grid_end_detected(void);
 
+// Return the exact period of the end state (0: Unknown)
+uint32_t grid_get_period(void);
+
+// Function to go back a number of generations
+// -> Generations which are not kept in the history are calculated again from the nearest one
+void grid_rewind(uint32_t gens);
+
+// Function to step through a recording instead of calculating the generations (see replay_open())
+void grid_update_replay(int32_t steps);
+
+// Function to show the newest generation of a server instead of calculating the generations (see stream_connect())
+void grid_update_remote(void);
+
+// Get the state of the current generation (only for the simulation thread)
+void grid_get_state(grid_state_t * state);
+
+// Get the state of the end detection of the current generation (only for the simulation thread)
+void grid_get_end_det_state(end_det_state_t * state);
+
+// Pack a grid into bits (see GRID_PACKED_SIZE())
+void grid_pack(const grid_t * grid, uint16_t width, uint16_t height, uint8_t * bits);
+
+// Unpack bits of a grid with the given size into the center of a grid
+void grid_unpack(grid_t * grid, const uint8_t * bits, uint16_t width, uint16_t height);
+
 
 
 #endif // __GRID_H
@@ -0,0 +1,235 @@
+
+// File:    history.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   History of the last generations in memory (to go back in time).
+//          The generations are stored like in a recording (see recorder.c): Every
+//          HISTORY_KEYFRAME generations a keyframe, in between the runs of changed bytes
+//          to the generation before. A keyframe with its deltas is a segment.
+//          If the history needs more than HISTORY_MEM_MAX, the deltas of the oldest
+//          segments are freed first, their keyframes are kept. So older generations can
+//          still be reached by calculating them again from the nearest keyframe. Only if
+//          the keyframes alone exceed the limit, the oldest ones are removed.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "history.h"
+#include "recorder.h"
+#include "grid.h"
+#include "debug_output.h"
+
+#define HISTORY_MEM_MAX  (64*1024*1024) // Memory for the history in bytes
+#define HISTORY_KEYFRAME 100            // Generations between two keyframes
+
+typedef struct
+{
+    uint32_t generation;  // Generation of the keyframe
+    uint16_t width;
+    uint16_t height;
+    uint32_t frames;      // Keyframe and deltas
+    uint32_t *offs;       // Begin of every frame in "data" (frames + 1 entries)
+    uint32_t offs_size;
+    uint8_t  *data;       // Runs of all frames
+    uint32_t data_size;
+} history_seg_t;
+
+static history_seg_t *segs     = NULL;
+static uint32_t      segs_cnt  = 0;
+static uint32_t      segs_size = 0;
+static uint32_t      segs_old  = 0; // Segments before this one have only their keyframe
+static size_t        mem       = 0; // Allocated memory of all segments
+static uint8_t       enabled   = 1;
+static uint8_t       prev_valid = 0; // "prev" is the last added generation
+static uint32_t      last_gen  = 0;
+static uint8_t       prev[GRID_PACKED_SIZE(GRID_WIDTH_MAX, GRID_HEIGHT_MAX)];
+static uint8_t       bits[GRID_PACKED_SIZE(GRID_WIDTH_MAX, GRID_HEIGHT_MAX)];
+static uint8_t       runs[RECORDER_RUNS_MAX(GRID_PACKED_SIZE(GRID_WIDTH_MAX, GRID_HEIGHT_MAX))];
+
+
+
+// Function to free a segment
+static void history_free_seg(history_seg_t * seg)
+{
+    mem -= seg->data_size + seg->offs_size * sizeof(seg->offs[0]);
+    free(seg->data);
+    free(seg->offs);
+    memset(seg, 0, sizeof(*seg));
+}
+
+
+
+// Function to clear the history
+void history_reset(void)
+{
+    for(uint32_t i=0; i<segs_cnt; i++)
+        history_free_seg(&segs[i]);
+    segs_cnt   = 0;
+    segs_old   = 0;
+    prev_valid = 0;
+}
+
+
+
+// Function to switch the history on or off (off: history_add() does nothing, e.g. for headless runs)
+void history_set_enabled(uint8_t enable)
+{
+    enabled = enable;
+    history_reset();
+}
+
+
+
+// Function to remove all generations from "generation" on
+static void history_truncate(uint32_t generation)
+{
+    while((segs_cnt > 0) && (segs[segs_cnt-1].generation >= generation))
+        history_free_seg(&segs[--segs_cnt]);
+    if(segs_cnt > 0)
+    {
+        history_seg_t *seg = &segs[segs_cnt-1];
+        if(seg->frames > generation - seg->generation)
+            seg->frames = generation - seg->generation;
+    }
+    if(segs_old > segs_cnt)
+        segs_old = segs_cnt;
+    prev_valid = 0;
+}
+
+
+
+// Function to keep the memory limit (frees the deltas of the oldest segments, then the oldest keyframes)
+static void history_limit(void)
+{
+    while((mem > HISTORY_MEM_MAX) && (segs_old + 1 < segs_cnt))
+    {
+        history_seg_t *seg = &segs[segs_old++];
+        uint32_t size = seg->offs[1];
+
+        mem -= seg->data_size + seg->offs_size * sizeof(seg->offs[0]);
+        if(size > 0)
+        {
+            seg->data      = realloc(seg->data, size);
+            seg->data_size = size;
+        }
+        seg->offs      = realloc(seg->offs, 2 * sizeof(seg->offs[0]));
+        seg->offs_size = 2;
+        seg->frames    = 1;
+        mem += seg->data_size + seg->offs_size * sizeof(seg->offs[0]);
+    }
+    while((mem > HISTORY_MEM_MAX) && (segs_cnt > 1))
+    {
+        history_free_seg(&segs[0]);
+        memmove(&segs[0], &segs[1], (segs_cnt - 1) * sizeof(segs[0]));
+        segs_cnt--;
+        if(segs_old > 0)
+            segs_old--;
+    }
+}
+
+
+
+// Function to add a generation to the history (only for the simulation thread)
+// -> Newer generations are removed, if "generation" is not after the last one
+void history_add(const grid_t * grid, uint16_t width, uint16_t height, uint32_t generation)
+{
+    uint32_t      size = GRID_PACKED_SIZE(width, height);
+    history_seg_t *seg = (segs_cnt > 0 ? &segs[segs_cnt-1] : NULL);
+
+    if(!enabled)
+    {
+        return;
+    }
+    if((segs_cnt > 0) && (generation <= last_gen))
+    {
+        history_truncate(generation);
+        seg = (segs_cnt > 0 ? &segs[segs_cnt-1] : NULL);
+    }
+    grid_pack(grid, width, height, bits);
+
+    // New segment for a new pattern, a gap, a new grid size or after the keyframe interval
+    if(    !prev_valid || (seg == NULL) || (generation != last_gen + 1)
+        || (seg->width != width) || (seg->height != height)
+        || (generation - seg->generation >= HISTORY_KEYFRAME)
+      )
+    {
+        if(segs_cnt == segs_size)
+        {
+            segs_size = (segs_size > 0 ? segs_size * 2 : 64);
+            segs      = realloc(segs, segs_size * sizeof(segs[0]));
+            if(segs == NULL)
+            {
+                exit(1);
+            }
+        }
+        seg = &segs[segs_cnt++];
+        memset(seg, 0, sizeof(*seg));
+        seg->generation = generation;
+        seg->width      = width;
+        seg->height     = height;
+        seg->offs_size  = HISTORY_KEYFRAME + 1;
+        seg->offs       = malloc(seg->offs_size * sizeof(seg->offs[0]));
+        if(seg->offs == NULL)
+        {
+            exit(1);
+        }
+        seg->offs[0] = 0;
+        mem += seg->offs_size * sizeof(seg->offs[0]);
+    }
+
+    // Append the runs to the segment
+    uint32_t len = recorder_encode_runs(bits, (seg->frames > 0 ? prev : NULL), size, runs);
+    uint32_t end = seg->offs[seg->frames];
+    if(end + len > seg->data_size)
+    {
+        uint32_t data_size = (end + len) + (end + len) / 2;
+        mem += data_size - seg->data_size;
+        seg->data      = realloc(seg->data, data_size);
+        seg->data_size = data_size;
+        if(seg->data == NULL)
+        {
+            exit(1);
+        }
+    }
+    if(len > 0)
+        memcpy(&seg->data[end], runs, len);
+    seg->frames++;
+    seg->offs[seg->frames] = end + len;
+
+    memcpy(prev, bits, size);
+    prev_valid = 1;
+    last_gen   = generation;
+    history_limit();
+}
+
+
+
+// Function to set the latest kept generation up to "generation" into the (cleared) grid
+// -> Generations which are not kept anymore have to be calculated again from the returned one
+// -> Returns the generation which has been set (HISTORY_NONE: Empty history)
+uint32_t history_get(uint32_t generation, grid_t * grid)
+{
+    uint32_t s = segs_cnt;
+
+    if(segs_cnt == 0)
+    {
+        return HISTORY_NONE;
+    }
+
+    // Latest segment before the generation (or the oldest one)
+    while((s > 1) && (segs[s-1].generation > generation))
+        s--;
+    history_seg_t *seg  = &segs[s-1];
+    uint32_t      size  = GRID_PACKED_SIZE(seg->width, seg->height);
+    uint32_t      frame = (generation > seg->generation ? generation - seg->generation : 0);
+    if(frame >= seg->frames)
+        frame = seg->frames - 1;
+
+    // Keyframe and deltas
+    memset(bits, 0, size);
+    for(uint32_t i=0; i<=frame; i++)
+        recorder_apply_runs(bits, size, &seg->data[seg->offs[i]], seg->offs[i+1] - seg->offs[i]);
+    grid_unpack(grid, bits, seg->width, seg->height);
+    return seg->generation + frame;
+}
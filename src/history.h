@@ -0,0 +1,34 @@
+
+// File:    history.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   History of the last generations in memory (to go back in time)
+
+#ifndef __HISTORY_H
+#define __HISTORY_H
+
+#include <stdint.h>
+#include "grid.h"
+
+#define HISTORY_NONE UINT32_MAX // No generation in the history
+
+
+
+// Function to clear the history
+void history_reset(void);
+
+// Function to switch the history on or off (off: history_add() does nothing, e.g. for headless runs)
+void history_set_enabled(uint8_t enable);
+
+// Function to add a generation to the history (only for the simulation thread)
+// -> Newer generations are removed, if "generation" is not after the last one
+void history_add(const grid_t * grid, uint16_t width, uint16_t height, uint32_t generation);
+
+// Function to set the latest kept generation up to "generation" into the (cleared) grid
+// -> Generations which are not kept anymore have to be calculated again from the returned one
+// -> Returns the generation which has been set (HISTORY_NONE: Empty history)
+uint32_t history_get(uint32_t generation, grid_t * grid);
+
+
+
+#endif // __HISTORY_H
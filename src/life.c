@@ -0,0 +1,439 @@
+
+// File:    life.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Reentrant simulation of the Game of Life.
+//          All state of a simulation (cells, statistics and end detection) is kept in its
+//          life_t, so any number of simulations can run in one process, also in parallel
+//          threads (one thread per simulation). The cells can also be owned by the caller (see
+//          life_create_on()), who can calculate the columns of a generation in parallel with
+//          life_calc_part() and take the generation with life_next(). The grid and the worker
+//          processes of the shards are simulated this way, so all of them count the generations
+//          and detect the end the same way.
+//          The simulation core (life, end_det and debug_output) is built as static library
+//          with "make lib".
+//
+// Rules:   https://en.wikipedia.org/wiki/Conway%27s_Game_of_Life
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "life.h"
+
+struct life_s
+{
+    uint16_t  width;
+    uint16_t  height;
+    uint32_t  stride;     // Distance of two columns in the cells
+    uint8_t   *cells;     // Current generation (cells[x * stride + y])
+    uint8_t   *cells_new; // Next generation
+    uint8_t   own_cells;  // Cells are freed with the simulation (see life_create())
+    uint32_t  cells_alive;
+    uint64_t  hash;
+    uint32_t  cycle_counter;
+    uint32_t  generation;
+    end_det_t *end_det;
+};
+
+
+
+// Create a simulation with a grid of the given size (all cells dead)
+// -> Returns NULL if the size is invalid or the memory could not be allocated
+life_t * life_create(uint16_t width, uint16_t height)
+{
+    life_t *life;
+
+    if((width == 0) || (height == 0))
+    {
+        return NULL;
+    }
+    life = life_create_on(width, height, height, NULL, NULL);
+    if(life == NULL)
+    {
+        return NULL;
+    }
+    life->own_cells = 1;
+    life->cells     = calloc((size_t)width * height, 1);
+    life->cells_new = calloc((size_t)width * height, 1);
+    if((life->cells == NULL) || (life->cells_new == NULL))
+    {
+        life_destroy(life);
+        return NULL;
+    }
+    life_start(life);
+    return life;
+}
+
+
+
+// Create a simulation on cells of the caller ("cells[x * stride + y]", not freed with the simulation)
+// -> "cells_new": Cells for the next generation (NULL: The generations are calculated by the caller, see life_next())
+// -> Returns NULL if the memory could not be allocated (use life_start() or life_load() before the first generation)
+life_t * life_create_on(uint16_t width, uint16_t height, uint32_t stride, uint8_t * cells, uint8_t * cells_new)
+{
+    life_t *life = calloc(1, sizeof(life_t));
+
+    if(life == NULL)
+    {
+        return NULL;
+    }
+    life->width     = width;
+    life->height    = height;
+    life->stride    = stride;
+    life->cells     = cells;
+    life->cells_new = cells_new;
+    life->end_det   = end_det_create();
+    if(life->end_det == NULL)
+    {
+        free(life);
+        return NULL;
+    }
+    return life;
+}
+
+
+
+// Free a simulation of life_create()
+void life_destroy(life_t * life)
+{
+    if(life == NULL)
+    {
+        return;
+    }
+    if(life->own_cells)
+    {
+        free(life->cells);
+        free(life->cells_new);
+    }
+    end_det_destroy(life->end_det);
+    free(life);
+}
+
+
+
+// Set the size of a simulation of life_create_on() (at most the stride, use life_start() or life_load() afterwards)
+void life_set_size(life_t * life, uint16_t width, uint16_t height)
+{
+    life->width  = width;
+    life->height = (height <= life->stride ? height : life->stride);
+}
+
+
+
+// Set the cells of a simulation of life_create_on() (e.g. after the caller has swapped them)
+void life_set_cells(life_t * life, uint8_t * cells, uint8_t * cells_new)
+{
+    life->cells     = cells;
+    life->cells_new = cells_new;
+}
+
+
+
+// Function to set the number of cycles which have to repeat for the end detection (used with the next life_start())
+void life_set_window(life_t * life, uint32_t window)
+{
+    end_det_ctx_set_window(life->end_det, window);
+}
+
+
+
+// Function to enable the debug output of the end detection (see debug_output.c)
+void life_set_debug(life_t * life, uint8_t debug)
+{
+    end_det_ctx_set_debug(life->end_det, debug);
+}
+
+
+
+// Set all cells of a simulation to dead (use life_start() afterwards)
+void life_clear(life_t * life)
+{
+    for(uint16_t x=0; x<life->width; x++)
+        memset(&life->cells[(uint32_t)x * life->stride], 0, life->height);
+}
+
+
+
+// Set a cell of a simulation (use life_start() afterwards)
+void life_set_cell(life_t * life, uint16_t x, uint16_t y, uint8_t alive)
+{
+    if((x < life->width) && (y < life->height))
+    {
+        life->cells[(uint32_t)x * life->stride + y] = (alive ? 1 : 0);
+    }
+}
+
+
+
+// Set the cells of a simulation from a grid (grid[x][y] for the size of the simulation, use life_start() afterwards)
+void life_set_grid(life_t * life, const grid_t * grid)
+{
+    for(uint16_t x=0; x<life->width; x++)
+        for(uint16_t y=0; y<life->height; y++)
+            life->cells[(uint32_t)x * life->stride + y] = (grid[x][y] ? 1 : 0);
+}
+
+
+
+// Start a simulation with its current cells as generation 0
+void life_start(life_t * life)
+{
+    life_load(life, 0, 0);
+}
+
+
+
+// Start a simulation with its current cells as the given generation (e.g. from a history or a snapshot)
+// -> "cycles": Cycles counted up to this generation (see life_get_cycles())
+void life_load(life_t * life, uint32_t generation, uint32_t cycles)
+{
+    life->cells_alive = 0;
+    life->hash        = 0;
+    for(uint16_t x=0; x<life->width; x++)
+    {
+        for(uint16_t y=0; y<life->height; y++)
+        {
+            if(life->cells[(uint32_t)x * life->stride + y])
+            {
+                life->cells_alive++;
+                life->hash ^= life_cell_key(x, y);
+            }
+        }
+    }
+    life->cycle_counter = cycles;
+    life->generation    = generation;
+    end_det_ctx_reset(life->end_det, life->hash);
+}
+
+
+
+// Function to calculate a number of generations of a simulation
+// -> Stops after "gens" generations or when the end is detected
+// -> Returns the number of calculated generations
+uint32_t life_step(life_t * life, uint32_t gens)
+{
+    uint8_t  end_detected = end_det_ctx_detected(life->end_det);
+    uint32_t gen;
+
+    for(gen=0; gen<gens; gen++)
+    {
+        uint64_t hash_diff;
+        uint32_t alive;
+        uint8_t  *cells;
+
+        alive = life_calc_part(life, 0, life->width, &hash_diff);
+        life_next(life, alive, life->hash ^ hash_diff);
+        cells           = life->cells;
+        life->cells     = life->cells_new;
+        life->cells_new = cells;
+
+        if(end_det_ctx_detected(life->end_det) && !end_detected)
+        {
+            gen++;
+            break;
+        }
+    }
+    return gen;
+}
+
+
+
+// Function to calculate the next generation of some columns of a simulation into its next cells (see life_calc_columns())
+// -> Columns of different parts can be calculated in parallel, the results are taken with life_next()
+uint32_t life_calc_part(const life_t * life, uint16_t x_beg, uint16_t x_cnt, uint64_t * hash)
+{
+    return life_calc_columns(life->cells, life->cells_new, life->stride, life->width, life->height, x_beg, x_cnt, 0, hash);
+}
+
+
+
+// Function to take the next generation of a simulation, which has been calculated outside of life_step()
+// -> "alive": Living cells of the whole generation, "hash": Hash of the whole generation
+// -> Counts the generation and detects the end, the cells are not swapped (see life_set_cells())
+void life_next(life_t * life, uint32_t alive, uint64_t hash)
+{
+    if(!end_det_ctx_detected(life->end_det))
+    {
+        life->cycle_counter++;
+    }
+    life->cells_alive = alive;
+    life->hash        = hash;
+    life->generation++;
+    end_det_ctx_handle(life->end_det, life->cells_alive, life->hash);
+}
+
+
+
+// Function to skip a number of generations in the periodic end state (e.g. from a cycle cache, no end detection)
+// -> "alive" and "hash": Living cells and hash of the generation "steps" after the current one
+void life_skip(life_t * life, uint32_t steps, uint32_t alive, uint64_t hash)
+{
+    life->cells_alive = alive;
+    life->hash        = hash;
+    life->generation += steps;
+}
+
+
+
+// Return "1" if a cell of a simulation is alive
+uint8_t life_get_cell(const life_t * life, uint16_t x, uint16_t y)
+{
+    return ((x < life->width) && (y < life->height) ? life->cells[(uint32_t)x * life->stride + y] : 0);
+}
+
+
+
+// Get count of cells which are alive
+uint32_t life_get_cells_alive(const life_t * life)
+{
+    return life->cells_alive;
+}
+
+
+
+// Get the Zobrist hash of the current generation (same as the hash of the grid)
+uint64_t life_get_hash(const life_t * life)
+{
+    return life->hash;
+}
+
+
+
+// Get the generation since life_start() (also after the end detection)
+uint32_t life_get_generation(const life_t * life)
+{
+    return life->generation;
+}
+
+
+
+// Get cycle counter (generations until the end state after the end detection, see grid_get_cycle_counter())
+uint32_t life_get_cycle_counter(const life_t * life)
+{
+    uint32_t detection_cycles = end_det_ctx_get_detection_cycles(life->end_det);
+
+    if(!end_det_ctx_detected(life->end_det))
+    {
+        return life->cycle_counter;
+    }
+    else if(life->cycle_counter >= detection_cycles)
+    {
+        return (life->cycle_counter - detection_cycles);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+
+
+// Get the cycles counted since life_start() (cycle counter without the end detection, e.g. for a snapshot)
+uint32_t life_get_cycles(const life_t * life)
+{
+    return life->cycle_counter;
+}
+
+
+
+// Return "1" if the end of the simulation has been detected
+uint8_t life_end_detected(const life_t * life)
+{
+    return end_det_ctx_detected(life->end_det);
+}
+
+
+
+// Return the exact period of the end state (0: Unknown, detected with the number of alive cells)
+uint32_t life_get_period(const life_t * life)
+{
+    return end_det_ctx_get_period(life->end_det);
+}
+
+
+
+// Get the state of the end detection of a simulation (e.g. for a snapshot)
+void life_get_end_state(const life_t * life, end_det_state_t * state)
+{
+    end_det_ctx_get_state(life->end_det, state);
+}
+
+
+
+// Set the state of the end detection of a simulation after life_start() or life_load()
+void life_set_end_state(life_t * life, const end_det_state_t * state)
+{
+    end_det_ctx_set_state(life->end_det, state, life->hash);
+}
+
+
+
+// Get the Zobrist key of a cell (splitmix64 of the position, no table needed)
+uint64_t life_cell_key(uint16_t x, uint16_t y)
+{
+    uint64_t z = (((uint64_t)x << 16) | y) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+
+
+// Function to calculate the next generation of some columns ("cells[x * stride + y]")
+// -> The hash is only updated for the cells which have changed ("hash": XOR of their keys)
+// -> "x_key": Added to x for the keys (cells which are only a part of a larger grid)
+// -> Returns the number of living cells in the columns
+uint32_t life_calc_columns(const uint8_t * cells, uint8_t * cells_new, uint32_t stride, uint16_t width, uint16_t height,
+                           uint16_t x_beg, uint16_t x_cnt, int32_t x_key, uint64_t * hash)
+{
+    uint16_t x, y;
+    uint32_t alive = 0;
+    uint64_t hash_diff = 0;
+
+    for(x=x_beg; x<(x_beg+x_cnt); x++)
+    {
+        for(y=0; y<height; y++)
+        {
+            uint32_t i = (uint32_t)x * stride + y;
+
+            // Count neighbors
+            uint8_t neighbors = 0;
+            for(int8_t dx=-1; dx<=1; dx++)
+            {
+                for(int8_t dy=-1; dy<=1; dy++)
+                {
+                    if(dx == 0 && dy == 0)
+                    {
+                        continue;
+                    }
+                    uint16_t nx = (width + x + dx) % width;
+                    uint16_t ny = (height + y + dy) % height;
+                    neighbors += cells[(uint32_t)nx * stride + ny];
+                }
+            }
+            // Calculate new state
+            // -> This way seems redundant (2 times the same else case), but it is more cpu efficient!
+            if(cells[i] == 0)
+            {
+                if(neighbors == 3)      // Reproduction
+                    cells_new[i] = 1;
+                else                    // Stasis
+                    cells_new[i] = cells[i];
+            }
+            else
+            {
+                if     (neighbors  < 2) // Underpopulation
+                    cells_new[i] = 0;
+                else if(neighbors  > 3) // Overpopulation
+                    cells_new[i] = 0;
+                else                    // Stasis
+                    cells_new[i] = cells[i];
+            }
+            alive += cells_new[i];
+            if(cells_new[i] != cells[i])
+                hash_diff ^= life_cell_key(x + x_key, y);
+        }
+    }
+    *hash = hash_diff;
+    return alive;
+}
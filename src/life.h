@@ -0,0 +1,119 @@
+
+// File:    life.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Reentrant simulation of the Game of Life (see life.c)
+
+#ifndef __LIFE_H
+#define __LIFE_H
+
+#include <stdint.h>
+#include "grid.h"
+#include "end_det.h"
+
+// Simulation with its own cells and end detection (see life_create())
+typedef struct life_s life_t;
+
+
+
+// Create a simulation with a grid of the given size (all cells dead)
+// -> Returns NULL if the size is invalid or the memory could not be allocated
+life_t * life_create(uint16_t width, uint16_t height);
+
+// Create a simulation on cells of the caller ("cells[x * stride + y]", not freed with the simulation)
+// -> "cells_new": Cells for the next generation (NULL: The generations are calculated by the caller, see life_next())
+// -> Returns NULL if the memory could not be allocated (use life_start() or life_load() before the first generation)
+life_t * life_create_on(uint16_t width, uint16_t height, uint32_t stride, uint8_t * cells, uint8_t * cells_new);
+
+// Free a simulation of life_create() or life_create_on()
+void life_destroy(life_t * life);
+
+// Set the size of a simulation of life_create_on() (at most the stride, use life_start() or life_load() afterwards)
+void life_set_size(life_t * life, uint16_t width, uint16_t height);
+
+// Set the cells of a simulation of life_create_on() (e.g. after the caller has swapped them)
+void life_set_cells(life_t * life, uint8_t * cells, uint8_t * cells_new);
+
+// Function to set the number of cycles which have to repeat for the end detection (used with the next life_start())
+void life_set_window(life_t * life, uint32_t window);
+
+// Function to enable the debug output of the end detection (see debug_output.c)
+void life_set_debug(life_t * life, uint8_t debug);
+
+// Set all cells of a simulation to dead (use life_start() afterwards)
+void life_clear(life_t * life);
+
+// Set a cell of a simulation (use life_start() afterwards)
+void life_set_cell(life_t * life, uint16_t x, uint16_t y, uint8_t alive);
+
+// Set the cells of a simulation from a grid (grid[x][y] for the size of the simulation, use life_start() afterwards)
+void life_set_grid(life_t * life, const grid_t * grid);
+
+// Start a simulation with its current cells as generation 0
+void life_start(life_t * life);
+
+// Start a simulation with its current cells as the given generation (e.g. from a history or a snapshot)
+// -> "cycles": Cycles counted up to this generation (see life_get_cycles())
+void life_load(life_t * life, uint32_t generation, uint32_t cycles);
+
+// Function to calculate a number of generations of a simulation
+// -> Stops after "gens" generations or when the end is detected
+// -> Returns the number of calculated generations
+uint32_t life_step(life_t * life, uint32_t gens);
+
+// Function to calculate the next generation of some columns of a simulation into its next cells (see life_calc_columns())
+// -> Columns of different parts can be calculated in parallel, the results are taken with life_next()
+uint32_t life_calc_part(const life_t * life, uint16_t x_beg, uint16_t x_cnt, uint64_t * hash);
+
+// Function to take the next generation of a simulation, which has been calculated outside of life_step()
+// -> "alive": Living cells of the whole generation, "hash": Hash of the whole generation
+// -> Counts the generation and detects the end, the cells are not swapped (see life_set_cells())
+void life_next(life_t * life, uint32_t alive, uint64_t hash);
+
+// Function to skip a number of generations in the periodic end state (e.g. from a cycle cache, no end detection)
+// -> "alive" and "hash": Living cells and hash of the generation "steps" after the current one
+void life_skip(life_t * life, uint32_t steps, uint32_t alive, uint64_t hash);
+
+// Return "1" if a cell of a simulation is alive
+uint8_t life_get_cell(const life_t * life, uint16_t x, uint16_t y);
+
+// Get count of cells which are alive
+uint32_t life_get_cells_alive(const life_t * life);
+
+// Get the Zobrist hash of the current generation (same as the hash of the grid)
+uint64_t life_get_hash(const life_t * life);
+
+// Get the generation since life_start() (also after the end detection)
+uint32_t life_get_generation(const life_t * life);
+
+// Get cycle counter (generations until the end state after the end detection, see grid_get_cycle_counter())
+uint32_t life_get_cycle_counter(const life_t * life);
+
+// Get the cycles counted since life_start() (cycle counter without the end detection, e.g. for a snapshot)
+uint32_t life_get_cycles(const life_t * life);
+
+// Return "1" if the end of the simulation has been detected
+uint8_t life_end_detected(const life_t * life);
+
+// Return the exact period of the end state (0: Unknown, detected with the number of alive cells)
+uint32_t life_get_period(const life_t * life);
+
+// Get the state of the end detection of a simulation (e.g. for a snapshot)
+void life_get_end_state(const life_t * life, end_det_state_t * state);
+
+// Set the state of the end detection of a simulation after life_start() or life_load()
+void life_set_end_state(life_t * life, const end_det_state_t * state);
+
+// Get the Zobrist key of a cell (the hash of a grid is the XOR of the keys of all living cells)
+uint64_t life_cell_key(uint16_t x, uint16_t y);
+
+// Function to calculate the next generation of some columns ("cells[x * stride + y]")
+// -> The hash is only updated for the cells which have changed ("hash": XOR of their keys)
+// -> "x_key": Added to x for the keys (cells which are only a part of a larger grid)
+// -> Returns the number of living cells in the columns
+uint32_t life_calc_columns(const uint8_t * cells, uint8_t * cells_new, uint32_t stride, uint16_t width, uint16_t height,
+                           uint16_t x_beg, uint16_t x_cnt, int32_t x_key, uint64_t * hash);
+
+
+
+#endif // __LIFE_H
@@ -0,0 +1,354 @@
+
+// File:    macrocell.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Import of Macrocell pattern files (quadtree)
+//          Every line of the file is one node of the quadtree, which is stored only once.
+//          Equal subtrees are referenced by their node number, so huge patterns with a
+//          lot of repetition stay small. The pattern is never expanded completely: Only
+//          the nodes which overlap the grid are visited, the columns of the grid are
+//          split up between some threads.
+//
+// Format:  https://conwaylife.com/wiki/Macrocell
+//          [M2] (header)
+//          #R B3/S23 (comments)
+//          ..*$...*$.***$ (leaf with 8x8 cells: "." dead, "*" alive, "$" end of row)
+//          4 1 0 2 3 (node of level 4 with its children nw ne sw se, 0: empty)
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "config.h"
+#include "macrocell.h"
+#include "grid.h"
+
+#define MC_LEVEL_LEAF    3 // Leaf with 8x8 cells
+#define MC_LEVEL_MAX    62 // Maximum level of the root (2^62 cells wide)
+
+typedef struct
+{
+    uint8_t  level;    // Node size: 2^level x 2^level cells
+    uint8_t  is_leaf;  // 8x8 cells in "leaf"
+    uint32_t child[4]; // Node numbers of nw, ne, sw, se (level 1: cell states)
+    uint64_t leaf;     // Cells of a leaf (bit: y*8 + x)
+    int64_t  bb[4];    // Bounding box of the living cells in the node: x_min, y_min, x_max, y_max (x_min > x_max: empty)
+} mc_node_t;
+
+typedef struct
+{
+    grid_t   *grid;
+    int64_t  x_beg;    // Columns of the grid for this thread
+    int64_t  x_end;
+} mc_thread_arg_t;
+
+static mc_node_t *nodes     = NULL; // Node number 0 is the empty node
+static uint32_t  nodes_cnt  = 0;
+static uint32_t  nodes_size = 0;
+static int64_t   root_x;            // Position of the root node in the grid
+static int64_t   root_y;
+
+
+
+// Function to parse an unsigned number
+static uint8_t macrocell_parse_uint(const char ** p, const char * end, uint32_t * val)
+{
+    uint8_t found = 0;
+
+    *val = 0;
+    while((*p < end) && (**p == ' '))
+        (*p)++;
+    while((*p < end) && (**p >= '0') && (**p <= '9'))
+    {
+        *val  = *val * 10 + (**p - '0');
+        found = 1;
+        (*p)++;
+    }
+    return found;
+}
+
+
+
+// Function to add a rectangle to the bounding box of a node
+static void macrocell_add_bb(mc_node_t * node, int64_t x_min, int64_t y_min, int64_t x_max, int64_t y_max)
+{
+    if(x_min < node->bb[0]) node->bb[0] = x_min;
+    if(y_min < node->bb[1]) node->bb[1] = y_min;
+    if(x_max > node->bb[2]) node->bb[2] = x_max;
+    if(y_max > node->bb[3]) node->bb[3] = y_max;
+}
+
+
+
+// Function to set the bounding box of a node from its cells or children
+static void macrocell_calc_bb(mc_node_t * node)
+{
+    node->bb[0] = INT64_MAX;
+    node->bb[1] = INT64_MAX;
+    node->bb[2] = INT64_MIN;
+    node->bb[3] = INT64_MIN;
+
+    if(node->is_leaf)
+    {
+        for(uint8_t i=0; i<64; i++)
+            if(node->leaf & ((uint64_t)1 << i))
+                macrocell_add_bb(node, i % 8, i / 8, i % 8, i / 8);
+    }
+    else if(node->level == 1)
+    {
+        for(uint8_t i=0; i<4; i++)
+            if(node->child[i] != 0)
+                macrocell_add_bb(node, i % 2, i / 2, i % 2, i / 2);
+    }
+    else
+    {
+        int64_t half = (int64_t)1 << (node->level - 1);
+        for(uint8_t i=0; i<4; i++)
+        {
+            mc_node_t *child = &nodes[node->child[i]];
+            if(child->bb[0] > child->bb[2]) // Empty
+                continue;
+            macrocell_add_bb(node, child->bb[0] + (i % 2) * half, child->bb[1] + (i / 2) * half,
+                                   child->bb[2] + (i % 2) * half, child->bb[3] + (i / 2) * half);
+        }
+    }
+}
+
+
+
+// Function to parse one leaf line with 8x8 cells
+static uint8_t macrocell_parse_leaf(const char * p, const char * end, mc_node_t * node)
+{
+    uint8_t x = 0;
+    uint8_t y = 0;
+
+    node->level   = MC_LEVEL_LEAF;
+    node->is_leaf = 1;
+    node->leaf    = 0;
+    for(; (p < end) && (*p != '\n') && (*p != '\r'); p++)
+    {
+        if(*p == '$')
+        {
+            x = 0;
+            y++;
+        }
+        else if((*p == '.') || (*p == '*'))
+        {
+            if((x >= 8) || (y >= 8))
+                return 0;
+            if(*p == '*')
+                node->leaf |= (uint64_t)1 << (y * 8 + x);
+            x++;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+
+// Function to parse one node line: "level nw ne sw se"
+static uint8_t macrocell_parse_node(const char * p, const char * end, mc_node_t * node)
+{
+    uint32_t level;
+
+    if(!macrocell_parse_uint(&p, end, &level) || (level < 1) || (level > MC_LEVEL_MAX))
+        return 0;
+    node->level   = level;
+    node->is_leaf = 0;
+    for(uint8_t i=0; i<4; i++)
+    {
+        if(!macrocell_parse_uint(&p, end, &node->child[i]))
+            return 0;
+        // Children have to be defined before and must be one level smaller
+        if((level > 1) && (node->child[i] != 0))
+        {
+            if(node->child[i] >= nodes_cnt)
+                return 0;
+            if(nodes[node->child[i]].level != level - 1)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+
+
+// Parse the nodes of a Macrocell file ("[M2]" format)
+// -> Returns "1" if the file is valid, otherwise "error" is set
+uint8_t macrocell_parse(const char * data, size_t size, const char ** error)
+{
+    const char *p   = data;
+    const char *end = data + size;
+
+    if((size < 4) || (memcmp(data, "[M2]", 4) != 0))
+    {
+        *error = "Macrocell header is missing";
+        return 0;
+    }
+
+    free(nodes);
+    nodes_size = 1024;
+    nodes_cnt  = 1;
+    nodes      = malloc(nodes_size * sizeof(nodes[0]));
+    if(nodes == NULL)
+    {
+        *error = "Out of memory";
+        return 0;
+    }
+    memset(&nodes[0], 0, sizeof(nodes[0]));
+    nodes[0].bb[0] = 1; // Empty node
+    nodes[0].bb[2] = 0;
+
+    while(p < end)
+    {
+        const char *line = p;
+        const char *nl   = memchr(p, '\n', end - p);
+        p = (nl != NULL ? nl + 1 : end);
+
+        if((line == data) || (*line == '#') || (*line == '\n') || (*line == '\r')) // Header, comments and empty lines
+            continue;
+
+        if(nodes_cnt == nodes_size)
+        {
+            mc_node_t *nodes_new = realloc(nodes, 2 * nodes_size * sizeof(nodes[0]));
+            if(nodes_new == NULL)
+            {
+                *error = "Out of memory";
+                return 0;
+            }
+            nodes       = nodes_new;
+            nodes_size *= 2;
+        }
+
+        mc_node_t *node = &nodes[nodes_cnt];
+        uint8_t   valid;
+        if((*line == '.') || (*line == '*') || (*line == '$'))
+            valid = macrocell_parse_leaf(line, end, node);
+        else
+            valid = macrocell_parse_node(line, end, node);
+        if(!valid)
+        {
+            *error = "Invalid node";
+            return 0;
+        }
+        macrocell_calc_bb(node);
+        nodes_cnt++;
+    }
+
+    if(nodes_cnt < 2)
+    {
+        *error = "No nodes";
+        return 0;
+    }
+    return 1;
+}
+
+
+
+// Get the width of the living cells in the pattern (bounding box)
+uint64_t macrocell_get_width(void)
+{
+    mc_node_t *root = &nodes[nodes_cnt - 1];
+    return (root->bb[0] <= root->bb[2] ? root->bb[2] - root->bb[0] + 1 : 0);
+}
+
+
+
+// Get the height of the living cells in the pattern (bounding box)
+uint64_t macrocell_get_height(void)
+{
+    mc_node_t *root = &nodes[nodes_cnt - 1];
+    return (root->bb[1] <= root->bb[3] ? root->bb[3] - root->bb[1] + 1 : 0);
+}
+
+
+
+// Function to set the visible cells of a node (x, y: position of the node in the grid)
+static void macrocell_expand(mc_thread_arg_t * arg, uint32_t num, int64_t x, int64_t y)
+{
+    mc_node_t *node = &nodes[num];
+
+    // Skip empty nodes and nodes outside of the visible columns and rows
+    if(    (node->bb[0] > node->bb[2])
+        || (x + node->bb[2] <  arg->x_beg) || (x + node->bb[0] >= arg->x_end)
+        || (y + node->bb[3] <  0)          || (y + node->bb[1] >= grid_get_height())
+      )
+    {
+        return;
+    }
+
+    if(node->is_leaf || (node->level == 1))
+    {
+        uint8_t size = (node->is_leaf ? 8 : 2);
+        for(uint8_t i=0; i<size*size; i++)
+        {
+            int64_t gx = x + (i % size);
+            int64_t gy = y + (i / size);
+            uint8_t alive = (node->is_leaf ? ((node->leaf >> i) & 1) : (node->child[i] != 0));
+            if(alive && (gx >= arg->x_beg) && (gx < arg->x_end) && (gy >= 0) && (gy < grid_get_height()))
+                arg->grid[gx][gy] = 1;
+        }
+    }
+    else
+    {
+        int64_t half = (int64_t)1 << (node->level - 1);
+        macrocell_expand(arg, node->child[0], x,        y);
+        macrocell_expand(arg, node->child[1], x + half, y);
+        macrocell_expand(arg, node->child[2], x,        y + half);
+        macrocell_expand(arg, node->child[3], x + half, y + half);
+    }
+}
+
+
+
+// Thread to set a subset of columns
+static void * macrocell_thread(void * args)
+{
+    macrocell_expand((mc_thread_arg_t *)args, nodes_cnt - 1, root_x, root_y);
+    return NULL;
+}
+
+
+
+// Set the part of the pattern which is visible in the grid (pattern center at the grid center)
+void macrocell_set_to_center(grid_t * grid)
+{
+    if((grid == 0) || (nodes_cnt < 2))
+    {
+        return;
+    }
+
+    mc_node_t *root = &nodes[nodes_cnt - 1];
+    if(root->bb[0] > root->bb[2]) // Empty
+    {
+        return;
+    }
+    root_x = ((int64_t)grid_get_width()  - (int64_t)macrocell_get_width())  / 2 - root->bb[0];
+    root_y = ((int64_t)grid_get_height() - (int64_t)macrocell_get_height()) / 2 - root->bb[1];
+
+    // Split the columns of the grid between the threads
+    uint16_t thread_cnt = grid_get_cpu_cores();
+    if(thread_cnt > grid_get_width()) thread_cnt = grid_get_width();
+    if(thread_cnt < 1)                thread_cnt = 1;
+    pthread_t       threads[thread_cnt];
+    mc_thread_arg_t args[thread_cnt];
+
+    for(int i=0; i<thread_cnt; i++)
+    {
+        args[i].grid  = grid;
+        args[i].x_beg = ((int)grid_get_width() * i)     / thread_cnt;
+        args[i].x_end = ((int)grid_get_width() * (i+1)) / thread_cnt;
+        if(pthread_create(&threads[i], NULL, macrocell_thread, (void *)&args[i]))
+        {
+            exit(1);
+        }
+    }
+    for(int i=0; i<thread_cnt; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+}
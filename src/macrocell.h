@@ -0,0 +1,31 @@
+
+// File:    macrocell.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Import of Macrocell pattern files (quadtree)
+
+#ifndef __MACROCELL_H
+#define __MACROCELL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "grid.h"
+
+
+
+// Parse the nodes of a Macrocell file ("[M2]" format)
+// -> Returns "1" if the file is valid, otherwise "error" is set
+uint8_t macrocell_parse(const char * data, size_t size, const char ** error);
+
+// Get the width of the living cells in the pattern (bounding box)
+uint64_t macrocell_get_width(void);
+
+// Get the height of the living cells in the pattern (bounding box)
+uint64_t macrocell_get_height(void);
+
+// Set the part of the pattern which is visible in the grid (pattern center at the grid center)
+void macrocell_set_to_center(grid_t * grid);
+
+
+
+#endif // __MACROCELL_H
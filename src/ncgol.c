@@ -10,10 +10,8 @@
 // Unicode: https://www.compart.com/en/unicode/block/U+2580
 //          https://www.compart.com/en/unicode/block/U+2800
 
-// TODO: Make speed more stable 0:Stop, 1:0,3 Hz, 2:1Hz, 3:3Hz, 4:10Hz, 5:30Hz, 6:100Hz, 7:300Hz, 8:1kHz, 9:As fast as possible
 // TODO: Decrease speed when end detected
 // TODO: Improve thread performance: Try start smaller threads and start next thread when the last one is finished
-// TODO: Improve keyboard key reaction time on lowest speeds or during end detected
 // TODO: Benchmark (calc without drawing of very large grid) --benchmark / -b
 // TODO: Add assert() from assert.h to check struct size from patterns
 // TODO: Add man page
@@ -28,8 +26,27 @@
 #include <time.h>
 #include <getopt.h>
 #include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#if(defined __linux__)
+    #include <sys/timerfd.h>
+    #include <sys/signalfd.h>
+#endif
 #include "config.h"
+#include "batch.h"
 #include "grid.h"
+#include "end_det.h"
+#include "sim.h"
+#include "timing.h"
+#include "term_out.h"
+#include "patfile.h"
+#include "snapshot.h"
+#include "recorder.h"
+#include "shm_out.h"
+#include "stream.h"
+#include "replay.h"
+#include "search.h"
 #include "debug_output.h"
 
 // Define SW name and Version
@@ -38,15 +55,21 @@
 #define AUTHOR_SHORT  "M. Ochs"
 #define AUTHOR_LONG   "Martin Ochs"
 
-static uint8_t grid_draw[GRID_WIDTH_MAX][GRID_HEIGHT_MAX];
+static const grid_frame_t * frame_draw;           // Frame which is drawn (taken from the simulation without copy)
+static const grid_t       * grid_draw;            // Cells of frame_draw: grid_draw[x][y]
 
-#define SPEED_MAX  9 // 0-9 allowed
+#define SPEED_MAX  TIMING_SPEED_MAX // 0-9 allowed, 10-19 turbo
 static uint8_t  speed;
 static float hz;
 
 static uint16_t grid_width;
 static uint16_t grid_height;
 
+static uint8_t   direct_output = 0; // Draw the grid window with term_out instead of ncurses
+static uint8_t   direct_active = 0; // Last frame has been drawn with term_out
+static pthread_t draw_thread;
+static uint8_t   draw_thread_running = 0;
+
 WINDOW *w_grid_box;
 WINDOW *w_grid;
 WINDOW *w_status_box;
@@ -85,6 +108,19 @@ static const char * charstyle_str[][2] =
     {"braille", "Braille 2x4"}
 };
 
+// Pre-encoded UTF-8 glyphs for the charstyles (filled by glyph_init())
+// -> Drawing a character is then only a table lookup instead of building a wchar_t and calling wcstombs()
+static char glyph_braille[256][4]; // Index: Bit 0..3 left column (top to bottom), bit 4..7 right column
+static uint32_t glyph_code_double[4];  // Glyph codes for term_out (same index as glyph_double[])
+static uint32_t glyph_code_cell[2][2]; // Glyph codes for term_out (Index: Cell alive, left/right character)
+#if(defined __linux__)
+    static const char * glyph_double[4] = {" ", "\u2580", "\u2584", "\u2588"}; // Index: Bit 0 upper cell, bit 1 lower cell
+    #define GLYPH_BLOCK "\u2588\u2588" // Two full blocks -> Looks best on a linux terminal which leaves no horizontal space between the blocks
+#else
+    static const char * glyph_double[4] = {" ", "\'", ".", ":"};
+    #define GLYPH_BLOCK "\u2588\u258a" // Full block and 3/4 block -> Looks best on a mac terminal which leaves a little horizontal space between the blocks
+#endif
+
 typedef enum
 {
     COLORS_DEFAULT = 0, // Already defined by ncurses with shell colors
@@ -116,16 +152,40 @@ static const char * automode_str[][2] =
     {"stop", "Stop after"}
 };
 
+#define DRAW_GRID_HZ         60 // Maximum rate for drawing the grid
+#define TIMEOUT_TOOSMALL    100 // Interval for checking a too small grid again
+
 #define TIMEOUT_STARTWAIT 20000
 #define TIMEOUT_SHOWINFO   2000
 #define TIMEOUT_END        5000
 static uint16_t timer;
 
+static int      frame_fd  = -1; // Timer for drawing the frames
+static int      signal_fd = -1; // Signals for terminal resize and termination
+static uint8_t  frame_timer_on = 0;
+#if !(defined __linux__)
+    static uint64_t frame_next_ms = 0; // Next frame without timerfd
+#endif
+static uint8_t  ui_dirty = 0;   // Frames to draw after a change of the screen (also without running simulation)
+static const char *export_path = NULL; // Export the last generation at the end of the program (--export)
+static const char *resume_path = NULL; // Snapshot to resume from and to save to (--resume)
+static uint32_t autosave_s = 60;       // Autosave interval of the snapshot in seconds (--autosave)
+static const char *record_path = NULL; // Record all generations into this file (--record)
+static const char *shm_name    = NULL; // Export the live grid into this shared memory (--shm)
+static uint16_t   serve_port  = 0;    // Stream the generations to viewers on this port (--serve)
+static uint8_t  reverse = 0;    // Play the recording backwards (--replay)
+static uint32_t goto_arg = SIM_GOTO_NONE;    // Jump to this generation after the first initialization (--goto)
+static uint32_t goto_target = SIM_GOTO_NONE; // Running fast forward (see sim_goto_get())
+static uint32_t goto_reached = 0;            // Reached generation of the fast forward
+#if !(defined __linux__)
+    static volatile sig_atomic_t terminate = 0; // SIGTERM received (without signalfd)
+#endif
+
 #define COMMAND_KEYS_STR "Command keys:\n"                                      \
                          "  \'q\'                 End program\n"                \
                          "  \'ESC\'               Close dialogs or timeouts\n"  \
                          "  \n"                                                 \
-                         "  \'Up\' and \'Down\'     Adjust speed\n"             \
+                         "  \'Up\' and \'Down\'     Adjust speed (above 9: turbo)\n" \
                          "  \'s\'                 Cycle through speed values\n" \
                          "  \'0\'...\'9\'           Set speed directly\n"       \
                          "  \n"                                                 \
@@ -135,6 +195,10 @@ static uint16_t timer;
                          "  \'Space\'             Restart current pattern\n"    \
                          "  \'c\'                 Change Charstyle\n"           \
                          "  \'m\'                 Change mode\n"                \
+                         "  \'e\'                 Export generation as RLE file\n" \
+                         "  \'b\' and \'B\'         Go back 1 or 100 generations\n" \
+                         "  \'g\'                 Fast forward to the end (ESC: stop)\n" \
+                         "  \'r\'                 Reverse replay (Left/Right: seek)\n" \
                          "  \'h\'                 Startupscreen\n"
 
 
@@ -142,6 +206,15 @@ static uint16_t timer;
 // Function to initialize the User Interface
 static void tui_init(void);
 
+// Function to fill the glyph tables for the charstyles
+static void glyph_init(void);
+
+// Function to convert a glyph string into a glyph code for term_out
+static uint32_t glyph_code(const char * str, uint8_t len);
+
+// Function to gather the 2x4 cells of a braille character into a dot mask
+static inline uint8_t glyph_braille_mask(uint16_t x, uint16_t y);
+
 // Function to determine if grid is too small
 static uint8_t grid_too_small(void);
 
@@ -154,9 +227,36 @@ static void tui_update(void);
 // Function to draw the grid on the canvas
 static void * tui_draw(void * args);
 
+// Function to encode one row of the grid window for term_out
+static void tui_encode_row(uint16_t row, uint32_t * cells, uint16_t cols);
+
+// Function to wait for the running tui_draw thread
+static void tui_draw_wait(void);
+
 // Function to handle input events
 static void handle_inputs(void);
 
+// Function to handle one key
+static void handle_key(int key);
+
+// Function to handle a resize of the terminal
+static void handle_resize(void);
+
+// Function to export the last drawn generation as RLE file
+static uint8_t export_rle(const char * path);
+
+// Function to end the program (saves the snapshot and exports the last generation)
+static void quit(void);
+
+// Function to start or stop the frame timer
+static void frame_timer_set(uint8_t on);
+
+// Function to check if the frame timer has expired
+static uint8_t frame_timer_expired(void);
+
+// Function to get the time until the next timeout of the current stage (-1: No timeout)
+static int stage_timeout_ms(void);
+
 // Function to handle one life cycle of the simulation
 int main(int argc, char * argv[]);
 
@@ -165,6 +265,78 @@ static void handle_args(int argc, char * argv[]);
 
 
 
+// Function to fill the glyph tables for the charstyles
+static void glyph_init(void)
+{
+    // Braille dot bits for the mask bits (left column: dots 1,2,3,7, right column: dots 4,5,6,8)
+    static const uint8_t dot[8] = {0x01, 0x02, 0x04, 0x40, 0x08, 0x10, 0x20, 0x80};
+
+    for(uint16_t mask=0; mask<256; mask++)
+    {
+        uint8_t braille = 0;
+        for(uint8_t bit=0; bit<8; bit++)
+        {
+            if(mask & (1 << bit))
+                braille |= dot[bit];
+        }
+
+        // UTF-8 encoding of U+2800 + braille (three bytes)
+        glyph_braille[mask][0] = 0xE2;
+        glyph_braille[mask][1] = 0xA0 | (braille >> 6);
+        glyph_braille[mask][2] = 0x80 | (braille & 0x3F);
+        glyph_braille[mask][3] = 0;
+    }
+
+    // Glyph codes for term_out
+    for(uint8_t i=0; i<4; i++)
+    {
+        glyph_code_double[i] = glyph_code(glyph_double[i], strlen(glyph_double[i]));
+    }
+    glyph_code_cell[0][0] = glyph_code(" ", 1);
+    glyph_code_cell[0][1] = glyph_code(" ", 1);
+    {
+        const char * cell = (charstyle == CHARSTYLE_BLOCK ? GLYPH_BLOCK : "# ");
+        uint8_t      len  = (charstyle == CHARSTYLE_BLOCK ? 3 : 1); // Bytes per character
+        glyph_code_cell[1][0] = glyph_code(cell,       len);
+        glyph_code_cell[1][1] = glyph_code(cell + len, len);
+    }
+}
+
+
+
+// Function to convert a glyph string into a glyph code for term_out
+static uint32_t glyph_code(const char * str, uint8_t len)
+{
+    char     bytes[4] = {0};
+    uint32_t code;
+
+    memcpy(bytes, str, (len < 4 ? len : 4));
+    memcpy(&code, bytes, 4);
+    return code;
+}
+
+
+
+// Function to gather the 2x4 cells of a braille character into a dot mask
+// -> The four cells of a column are adjacent bytes (0 or 1) in grid_draw[x][y].
+//    One multiplication moves them into the upper nibble without any branches.
+static inline uint8_t glyph_braille_mask(uint16_t x, uint16_t y)
+{
+    uint32_t left, right;
+    memcpy(&left,  &grid_draw[x+0][y], 4);
+    memcpy(&right, &grid_draw[x+1][y], 4);
+
+    #if (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        #define GATHER4(v) ((((v) * 0x08040201u) >> 24) & 0x0F)
+    #else
+        #define GATHER4(v) ((((v) * 0x01020408u) >> 24) & 0x0F)
+    #endif
+    return GATHER4(left) | (GATHER4(right) << 4);
+    #undef GATHER4
+}
+
+
+
 // Function to initialize the User Interface
 static void tui_init(void)
 {
@@ -173,8 +345,12 @@ static void tui_init(void)
         debug_init();
     #endif
 
+    // Wait for drawing, because the windows are recreated
+    tui_draw_wait();
+
     // Set locale
     setlocale(LC_ALL, "");
+    glyph_init();
 
     // Initialize ncurses
     initscr();   // Determine terminal type
@@ -221,6 +397,8 @@ static void tui_init(void)
     nodelay(w_grid, TRUE); // Non-blocking input
     keypad(w_grid, TRUE); // Enable special keys
     wrefresh(w_grid);
+    term_out_init(getbegy(w_grid), getbegx(w_grid), getmaxy(w_grid), getmaxx(w_grid));
+    direct_active = 0;
 
     // Init
     if     (charstyle == CHARSTYLE_BRAILLE)
@@ -240,8 +418,7 @@ static void tui_init(void)
     }
     if(grid_width  > GRID_WIDTH_MAX)  grid_width  = GRID_WIDTH_MAX;
     if(grid_height > GRID_HEIGHT_MAX) grid_height = GRID_HEIGHT_MAX;
-    grid_set_size(grid_width, grid_height);
-    memset(grid_draw, 0, sizeof(grid_draw));
+    sim_set_size(grid_width, grid_height);
 
     #if (WITH_DEBUG_OUTPUT)
         debug_printf("Grid size: %ux%u\n", grid_width, grid_height);
@@ -295,102 +472,81 @@ static void * tui_draw(void * args)
     uint16_t x, y;
     char str[16];
 
-    // Draw grid to canvas
-    wattron(w_grid, A_BOLD | COLOR_PAIR(COLORS_LIVE_CELL));
-    for(x=0; x<grid_width; x++)
+    // Draw grid to canvas (not during a fast forward)
+    if(goto_target != SIM_GOTO_NONE)
+    {
+        werase(w_grid);
+    }
+    else if(direct_output && (stage == STAGE_RUNNING))
     {
-        for(y=0; y<grid_height; y++)
+        // Direct output with term_out -> Only without messages in the grid window
+        if(!direct_active)
+        {
+            term_out_invalidate();
+            direct_active = 1;
+        }
+        term_out_frame(tui_encode_row);
+    }
+    else
+    {
+        if(direct_active)
+        {
+            redrawwin(w_grid); // Terminal content is unknown to ncurses
+            direct_active = 0;
+        }
+        wattron(w_grid, A_BOLD | COLOR_PAIR(COLORS_LIVE_CELL));
+        if(charstyle == CHARSTYLE_BRAILLE)
         {
-            if(charstyle == CHARSTYLE_DOUBLE)
+            // The braille characters allows the usage of 8 dots per character
+            for(y=0; y<grid_height; y+=4)
             {
-                // Two dots per character
-                if(grid_draw[x][y] && grid_draw[x][y + 1])
+                for(x=0; x<grid_width; x+=2)
                 {
-                    // Both dots
-                    #if(defined __linux__)
-                        mvwaddstr(w_grid, y/2, x, "\u2588");
-                    #else
-                        mvwaddch(w_grid, y/2, x, ':');
-                    #endif
+                    mvwaddstr(w_grid, y/4, x/2, glyph_braille[glyph_braille_mask(x, y)]);
                 }
-                else if(grid_draw[x][y])
-                {
-                    // Upper dot
-                    #if(defined __linux__)
-                        mvwaddstr(w_grid, y/2, x, "\u2580");
-                    #else
-                        mvwaddch(w_grid, y/2, x, '\'');
-                    #endif
-                }
-                else if(grid_draw[x][y + 1])
-                {
-                    // Lower dot
-                    #if(defined __linux__)
-                        mvwaddstr(w_grid, y/2, x, "\u2584");
-                    #else
-                        mvwaddch(w_grid, y/2, x, '.');
-                    #endif
-                }
-                else
-                {
-                    mvwaddch(w_grid, y/2, x, ' ');
-                }
-                y++;
             }
-            else if(charstyle == CHARSTYLE_BRAILLE)
-            {
-                // The braille characters allows the usage of 8 dots per character
-                uint16_t braille = 0;
-                wchar_t braille_char;
-                char braille_str[4] = {0};
-
-                // Convert grid to braille unicode character
-                if(grid_draw[x+0][y+0]) {braille |= 0x01;}
-                if(grid_draw[x+0][y+1]) {braille |= 0x02;}
-                if(grid_draw[x+0][y+2]) {braille |= 0x04;}
-                if(grid_draw[x+0][y+3]) {braille |= 0x40;}
-                if(grid_draw[x+1][y+0]) {braille |= 0x08;}
-                if(grid_draw[x+1][y+1]) {braille |= 0x10;}
-                if(grid_draw[x+1][y+2]) {braille |= 0x20;}
-                if(grid_draw[x+1][y+3]) {braille |= 0x80;}
-                braille |= 0x2800;
-                braille_char = braille;
-                wcstombs(braille_str, &braille_char, 4);
-
-                mvwaddstr(w_grid, y/4, x/2, braille_str);
-
-                y+=3;
-                if(y >= (grid_height-1))
-                    x+=1;
-            }
-            else
+        }
+        else if(charstyle == CHARSTYLE_DOUBLE)
+        {
+            // Two dots per character
+            for(y=0; y<grid_height; y+=2)
             {
-                // Two characters represent one cell
-                // Using background color with an empy space works not very well in ncurses,
-                // because the background color is only dimmed and not bright.
-                // A unicode full block uses the foreground color and works better.
-                if(grid_draw[x][y])
+                for(x=0; x<grid_width; x++)
                 {
-                    if     (charstyle == CHARSTYLE_BLOCK)
-                        #if(defined __linux__)
-                            mvwaddstr(w_grid, y, x*2, "\u2588\u2588"); // Two full blocks -> Looks best on a linux terminal which leaves no horizontal space between the blocks
-                        #else
-                            mvwaddstr(w_grid, y, x*2, "\u2588\u258a"); // Full block and 3/4 block -> Looks best on a mac terminal which leaves a little horizontal space between the blocks
-                        #endif
-                    else          // CHARSTYLE_HASH
-                        mvwaddstr(w_grid, y, x*2, "# ");               // #  -> Looks best on a terminal which has problems with unicode characters
+                    mvwaddstr(w_grid, y/2, x, glyph_double[grid_draw[x][y] | (grid_draw[x][y+1] << 1)]);
                 }
-                else
+            }
+        }
+        else
+        {
+            // Two characters represent one cell
+            // Using background color with an empy space works not very well in ncurses,
+            // because the background color is only dimmed and not bright.
+            // A unicode full block uses the foreground color and works better.
+            const char * glyph_cell = (charstyle == CHARSTYLE_BLOCK ? GLYPH_BLOCK : "# ");
+            for(y=0; y<grid_height; y++)
+            {
+                for(x=0; x<grid_width; x++)
                 {
-                    mvwaddstr(w_grid, y, x*2, "  ");
+                    mvwaddstr(w_grid, y, x*2, (grid_draw[x][y] ? glyph_cell : "  "));
                 }
             }
         }
+        wattroff(w_grid, A_BOLD | COLOR_PAIR(COLORS_LIVE_CELL));
     }
-    wattroff(w_grid, A_BOLD | COLOR_PAIR(COLORS_LIVE_CELL));
 
     // Handle grid screen messages
-    if((stage == STAGE_STARTUP) || (stage == STAGE_STARTWAIT))
+    if(goto_target != SIM_GOTO_NONE)
+    {
+        // Handle progress of the fast forward
+        char str_goto[64];
+        if(goto_target == SIM_GOTO_END)
+            sprintf(str_goto, "Fast forward to the end: Generation %u", goto_reached);
+        else
+            sprintf(str_goto, "Fast forward: Generation %u of %u", goto_reached, goto_target);
+        draw_str_in_frame(str_goto);
+    }
+    else if((stage == STAGE_STARTUP) || (stage == STAGE_STARTWAIT))
     {
         // Handle startup screen
         wmove(w_grid, 0, 0);
@@ -410,8 +566,17 @@ static void * tui_draw(void * args)
     }
     else if(stage == STAGE_END)
     {
-        // Handle end message
-        draw_str_in_frame("Simulation End");
+        // Handle end message (with the period, if it is known exactly)
+        if((frame_draw != NULL) && (frame_draw->period > 1))
+        {
+            char str_end[40];
+            sprintf(str_end, "Simulation End (Period %u)", frame_draw->period);
+            draw_str_in_frame(str_end);
+        }
+        else
+        {
+            draw_str_in_frame("Simulation End");
+        }
     }
 
     // Handle status line
@@ -420,7 +585,7 @@ static void * tui_draw(void * args)
         char str_label[20]; // Either for complete label or split up into: (Empty char | Highlighted char | Rest of label)
         char str_label2[20];
         char str_label3[20];
-        char str_value[30];
+        char str_value[48];
         uint16_t pos   = 0;
         uint16_t width = getmaxx(w_status);
         wmove(w_status, 0, 0);
@@ -453,7 +618,15 @@ static void * tui_draw(void * args)
         {
             // Cycles
             strcpy(str_label, " Cycles:");
-            sprintf(str_value, "%3u", grid_get_cycle_counter());
+            sprintf(str_value, "%3u", frame_draw->cycle_counter);
+            if(recorder_get_skipped() > 0) // Generations which are missing in the recording
+            {
+                sprintf(str_value + strlen(str_value), " Skipped:%u", recorder_get_skipped());
+            }
+            if(recorder_get_error() != NULL) // Recording stopped
+            {
+                strcat(str_value, " Recording failed");
+            }
             if((getcurx(w_status)+strlen(str_label)+strlen(str_value)) < width)
             {
                 wattron(w_status, COLOR_PAIR(COLORS_LABEL));
@@ -465,7 +638,7 @@ static void * tui_draw(void * args)
 
             // Cells
             strcpy(str_label, " Cells:");
-            sprintf(str_value, "%3u", grid_get_cells_alive());
+            sprintf(str_value, "%3u", frame_draw->cells_alive);
             if((getcurx(w_status)+strlen(str_label)+strlen(str_value)) < width)
             {
                 wattron(w_status, COLOR_PAIR(COLORS_LABEL));
@@ -487,6 +660,10 @@ static void * tui_draw(void * args)
             {
                 sprintf(str_value, "%u (%0.0f Hz)", speed, hz);
             }
+            if(timing_get_missed() > 0) // Missed deadlines at this speed
+            {
+                sprintf(str_value + strlen(str_value), " Late:%u", timing_get_missed());
+            }
             if((getcurx(w_status)+strlen(str_label)+strlen(str_label2)+strlen(str_label3)+strlen(str_value)) < width)
             {
                 wattron(w_status, COLOR_PAIR(COLORS_LABEL));
@@ -665,20 +842,70 @@ static void * tui_draw(void * args)
 
 
 
+// Function to encode one row of the grid window for term_out
+static void tui_encode_row(uint16_t row, uint32_t * cells, uint16_t cols)
+{
+    uint16_t col = 0;
+
+    if(charstyle == CHARSTYLE_BRAILLE)
+    {
+        for(; (col < cols) && (col*2 < grid_width) && (row*4 < grid_height); col++)
+        {
+            memcpy(&cells[col], glyph_braille[glyph_braille_mask(col*2, row*4)], 4);
+        }
+    }
+    else if(charstyle == CHARSTYLE_DOUBLE)
+    {
+        for(; (col < cols) && (col < grid_width) && (row*2 < grid_height); col++)
+        {
+            cells[col] = glyph_code_double[grid_draw[col][row*2] | (grid_draw[col][row*2+1] << 1)];
+        }
+    }
+    else
+    {
+        for(; (col+1 < cols) && (col/2 < grid_width) && (row < grid_height); col+=2)
+        {
+            cells[col+0] = glyph_code_cell[grid_draw[col/2][row]][0];
+            cells[col+1] = glyph_code_cell[grid_draw[col/2][row]][1];
+        }
+    }
+
+    // Rest of the row is not part of the grid
+    for(; col < cols; col++)
+    {
+        cells[col] = glyph_code_cell[0][0];
+    }
+}
+
+
+
+// Function to wait for the running tui_draw thread
+static void tui_draw_wait(void)
+{
+    if(draw_thread_running)
+    {
+        pthread_join(draw_thread, NULL);
+        draw_thread_running = 0;
+    }
+}
+
+
+
 // Function to update the grid on the canvas (starts thread with tui_draw)
 static void tui_update(void)
 {
-    static pthread_t thread;
-
-    pthread_join(thread, NULL); // Wait for last thread to finish -> Should be done by now, but just in case
+    tui_draw_wait();            // Wait for last thread to finish -> Should be done by now, but just in case
     wrefresh(w_grid);           // Refresh window -> This has to be done outside of the thread!
     wrefresh(w_status);
-    memcpy(grid_draw, grid_get(), sizeof(grid_draw));
-    if(pthread_create(&thread, NULL, tui_draw, NULL)) // During this drawing no wrefresh() on w_grid should be called (Caution: getch() in handle_inputs() is also a wrefresh()!)
+    term_out_write();           // Output of a direct frame -> Also outside of the thread (same terminal as ncurses)
+    frame_draw = grid_get_frame();
+    grid_draw  = frame_draw->cells;
+    if(pthread_create(&draw_thread, NULL, tui_draw, NULL)) // During this drawing no wrefresh() on w_grid should be called (Caution: getch() in handle_inputs() is also a wrefresh()!)
     {
         endwin();
         exit(1);
     }
+    draw_thread_running = 1;
 }
 
 
@@ -686,8 +913,34 @@ static void tui_update(void)
 // Function to handle input events
 static void handle_inputs(void)
 {
-    int key = wgetch(w_status);
+    int key;
+
+    // Read all available keys (non-blocking)
+    while((key = wgetch(w_status)) != ERR)
+    {
+        handle_key(key);
+    }
+}
+
+
+
+// Function to handle a resize of the terminal
+static void handle_resize(void)
+{
+    struct winsize ws;
+
+    if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0)
+    {
+        resizeterm(ws.ws_row, ws.ws_col);
+    }
+    handle_key(KEY_RESIZE);
+}
+
+
 
+// Function to handle one key
+static void handle_key(int key)
+{
     // Ncurses resize of Terminal
     if(key==KEY_RESIZE)
     {
@@ -698,14 +951,17 @@ static void handle_inputs(void)
     // "q" to end program
     else if(tolower(key) == 'q')
     {
-        endwin();
-        exit(0);
+        quit();
     }
 
     // "ESC" to close dialogs or timeouts
     if(key==27) // ESC
     {
-        if     (stage == STAGE_STARTWAIT)
+        if     (goto_target != SIM_GOTO_NONE)
+        {
+            sim_goto(SIM_GOTO_NONE);
+        }
+        else if(stage == STAGE_STARTWAIT)
         {
             stage = STAGE_INIT;
         }
@@ -742,16 +998,45 @@ static void handle_inputs(void)
         speed = key - '0';
     }
 
+    // "Left" and "Right" to seek in a recording (one keyframe interval)
+    else if(replay_is_open() && ((key == KEY_LEFT) || (key == KEY_RIGHT)))
+    {
+        sim_seek((key == KEY_LEFT ? -1 : 1) * (int32_t)replay_get_keyframe());
+        ui_dirty = 2;
+    }
+
+    // "b" and "B" to go back 1 or 100 generations
+    else if((key == 'b') || (key == 'B'))
+    {
+        sim_rewind(key == 'b' ? 1 : 100);
+        ui_dirty = 2;
+    }
+
+    // "g" to fast forward to the end (again: stop)
+    else if(tolower(key) == 'g')
+    {
+        sim_goto(goto_target == SIM_GOTO_NONE ? SIM_GOTO_END : SIM_GOTO_NONE);
+    }
+
+    // "r" to reverse the replay of a recording
+    else if(replay_is_open() && (tolower(key) == 'r'))
+    {
+        reverse = !reverse;
+        sim_set_reverse(reverse);
+    }
+
     // "Left" and "Right" to change pattern, "p" to cycle through patterns
+    // -> A pattern from a file is left to the first or last pattern
     else if(key == KEY_LEFT)
     {
-        if(initpattern == 0) initpattern = INITPATTERN_CYCLEMAX - 1;
-        else                 initpattern--;
+        if((initpattern == 0) || (initpattern >= INITPATTERN_CYCLEMAX)) initpattern = INITPATTERN_CYCLEMAX - 1;
+        else                                                             initpattern--;
         stage = STAGE_INIT;
     }
     else if((tolower(key) == 'p' || key == KEY_RIGHT))
     {
-        initpattern++;
+        if(initpattern >= INITPATTERN_CYCLEMAX) initpattern = 0;
+        else                                    initpattern++;
         initpattern %= INITPATTERN_CYCLEMAX;
         stage = STAGE_INIT;
     }
@@ -783,6 +1068,14 @@ static void handle_inputs(void)
         stage = STAGE_STARTUP;
     }
 
+    // "e" to export the current generation
+    else if(tolower(key) == 'e')
+    {
+        char path[32];
+        sprintf(path, "ncgol_%u.rle", (frame_draw != NULL ? frame_draw->cycle_counter : 0));
+        export_rle(path);
+    }
+
     else
     {
         // Do nothing
@@ -791,6 +1084,136 @@ static void handle_inputs(void)
 
 
 
+// Function to export the last drawn generation as RLE file
+static uint8_t export_rle(const char * path)
+{
+    if(frame_draw == NULL)
+    {
+        return 0;
+    }
+    #if (WITH_DEBUG_OUTPUT)
+        debug_printf("Export generation %u to %s\n", frame_draw->cycle_counter, path);
+    #endif
+    return patfile_save_rle(path, frame_draw->cells, frame_draw->width, frame_draw->height, frame_draw->cycle_counter);
+}
+
+
+
+// Function to end the program (saves the snapshot and exports the last generation)
+static void quit(void)
+{
+    endwin();
+    if(resume_path != NULL)
+    {
+        sim_save();
+    }
+    recorder_close();
+    if(recorder_get_skipped() > 0)
+    {
+        printf("Recording to %s: %u generations skipped (writing too slow)\n", record_path, recorder_get_skipped());
+    }
+    if(recorder_get_error() != NULL)
+    {
+        printf("Recording to %s failed: %s\n", record_path, recorder_get_error());
+    }
+    stream_close();
+    shm_out_close();
+    if(export_path != NULL)
+    {
+        if(!export_rle(export_path))
+        {
+            printf("Export to %s failed\n", export_path);
+            exit(1);
+        }
+    }
+    exit(0);
+}
+
+
+
+#if !(defined __linux__)
+// Function to handle SIGTERM (without signalfd)
+static void handle_sigterm(int sig)
+{
+    (void)sig;
+    terminate = 1;
+}
+#endif
+
+
+
+// Function to start or stop the frame timer
+static void frame_timer_set(uint8_t on)
+{
+    if(on == frame_timer_on)
+        return;
+    frame_timer_on = on;
+
+    #if(defined __linux__)
+        struct itimerspec its = {0};
+        if(on)
+        {
+            its.it_value.tv_nsec    = 1000000000 / DRAW_GRID_HZ;
+            its.it_interval.tv_nsec = 1000000000 / DRAW_GRID_HZ;
+        }
+        timerfd_settime(frame_fd, 0, &its, NULL);
+    #else
+        frame_next_ms = timing_now_ms() + (1000 / DRAW_GRID_HZ);
+    #endif
+}
+
+
+
+// Function to check if the frame timer has expired
+static uint8_t frame_timer_expired(void)
+{
+    #if(defined __linux__)
+        uint64_t expirations;
+        return (read(frame_fd, &expirations, sizeof(expirations)) == sizeof(expirations));
+    #else
+        if(frame_timer_on && (timing_now_ms() >= frame_next_ms))
+        {
+            frame_next_ms += (1000 / DRAW_GRID_HZ);
+            if(frame_next_ms < timing_now_ms())
+                frame_next_ms = timing_now_ms() + (1000 / DRAW_GRID_HZ);
+            return 1;
+        }
+        return 0;
+    #endif
+}
+
+
+
+// Function to get the time until the next timeout of the current stage (-1: No timeout)
+static int stage_timeout_ms(void)
+{
+    int timeout = -1;
+
+    if     (stage == STAGE_STARTWAIT)
+        timeout = (timer < TIMEOUT_STARTWAIT ? TIMEOUT_STARTWAIT - timer : 0);
+    else if(stage == STAGE_SHOWINFO)
+        timeout = (timer < TIMEOUT_SHOWINFO  ? TIMEOUT_SHOWINFO  - timer : 0);
+    else if((stage == STAGE_END) && (automode != AUTOMODE_STOP))
+        timeout = (timer < TIMEOUT_END       ? TIMEOUT_END       - timer : 0);
+    else if((stage == STAGE_STARTUP) || (stage == STAGE_INIT))
+        timeout = (grid_too_small() ? TIMEOUT_TOOSMALL : 0);
+
+    #if !(defined __linux__)
+        // No timerfd -> Wake up for the next frame
+        if(frame_timer_on)
+        {
+            uint64_t now = timing_now_ms();
+            int frame_timeout = (frame_next_ms > now ? frame_next_ms - now : 0);
+            if((timeout < 0) || (frame_timeout < timeout))
+                timeout = frame_timeout;
+        }
+    #endif
+
+    return timeout;
+}
+
+
+
 // Function to handle one life cycle of the simulation
 int main(int argc, char * argv[])
 {
@@ -800,50 +1223,138 @@ int main(int argc, char * argv[])
     automode    = AUTOMODE_NEXT;
     charstyle       = CHARSTYLE_HASH;
 
+    // Headless batch mode ("ncgol run ...")
+    if((argc > 1) && (strcmp(argv[1], "run") == 0))
+    {
+        return batch_main(argc - 1, &argv[1]);
+    }
+
+    // Soup search ("ncgol search ...")
+    if((argc > 1) && (strcmp(argv[1], "search") == 0))
+    {
+        return search_main(argc - 1, &argv[1]);
+    }
+
     // Handle commandline arguments
     handle_args(argc, argv);
 
+    // Terminal resize and termination are handled in the event loop -> Block the signals for all threads
+    // (without signalfd the resize is reported by ncurses as KEY_RESIZE)
+    sigset_t sigmask;
+    sigemptyset(&sigmask);
+    sigaddset(&sigmask, SIGWINCH);
+    sigaddset(&sigmask, SIGTERM);
+    #if(defined __linux__)
+        pthread_sigmask(SIG_BLOCK, &sigmask, NULL);
+    #else
+        signal(SIGTERM, handle_sigterm);
+    #endif
+
+    // Start the recording (the writer thread inherits the blocked signals)
+    if((record_path != NULL) && !recorder_open(record_path))
+    {
+        printf("Recording to %s failed\n", record_path);
+        exit(1);
+    }
+
+    // Start the server for the viewers (the server thread inherits the blocked signals)
+    if((serve_port != 0) && !stream_serve(serve_port))
+    {
+        printf("Port %u can not be opened\n", serve_port);
+        exit(1);
+    }
+
+    // Export of the live grid (the frames of the grid are placed into the shared memory)
+    if((shm_name != NULL) && !shm_out_open(shm_name))
+    {
+        printf("Shared memory %s can not be created\n", shm_name);
+        exit(1);
+    }
+
     // Initialize ncurses and grid
     tui_init();
+    sim_set_snapshot(resume_path, autosave_s);
+    sim_start();
 
-    // Init
-    static uint16_t last_systime_ms;
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    last_systime_ms = ts.tv_nsec / 1000000;
+    // Init event sources
+    enum
+    {
+        EVENT_KEYS,   // Input from stdin
+        EVENT_FRAME,  // Frame timer (timerfd)
+        EVENT_SIGNAL, // SIGWINCH and SIGTERM (signalfd)
+        EVENT_MAX
+    };
+    struct pollfd events[EVENT_MAX];
+    #if(defined __linux__)
+        frame_fd  = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        signal_fd = signalfd(-1, &sigmask, SFD_NONBLOCK | SFD_CLOEXEC);
+    #endif
+    events[EVENT_KEYS].fd   = STDIN_FILENO;
+    events[EVENT_FRAME].fd  = frame_fd;
+    events[EVENT_SIGNAL].fd = signal_fd;
+    for(uint8_t i=0; i<EVENT_MAX; i++)
+    {
+        events[i].events = POLLIN;
+    }
+
+    static uint64_t last_systime_ms;
+    last_systime_ms = timing_now_ms();
+    ui_dirty = 2;
 
-    // Mainloop
+    // Mainloop -> Sleeps until a key, a frame, a resize or a timeout of the current stage
+    // The generations are calculated in the simulation thread with their own deadlines.
     while(1)
     {
-        uint16_t systime_ms;
+        uint64_t systime_ms;
         uint16_t ticks; // Passed time in milliseconds for last cycle
+        stage_t  last_stage = stage;
+
+        // Wait for events
+        if(poll(events, EVENT_MAX, stage_timeout_ms()) < 0)
+        {
+            for(uint8_t i=0; i<EVENT_MAX; i++)
+                events[i].revents = 0;
+        }
 
-        // Handle passed time
-        clock_gettime(CLOCK_REALTIME, &ts);
-        systime_ms = ts.tv_nsec / 1000000;
-        ticks = (systime_ms - last_systime_ms + 1000) % 1000;
+        // Handle passed time (monotonic clock)
+        systime_ms = timing_now_ms();
+        ticks = ((systime_ms - last_systime_ms) < 0xFFFF ? (systime_ms - last_systime_ms) : 0xFFFF);
         timer += ticks;
         last_systime_ms = systime_ms;
 
-        // Handle input
-        handle_inputs();
-
-        // Handle speed
-        if     (speed == 0)         usleep(500000); // Stop
-        else if(speed == 1)         usleep(500000); // ~2 Hz
-        else if(speed == 2)         usleep(100000);
-        else if(speed == 3)         usleep( 50000);
-        else if(speed == 4)         usleep( 10000);
-        else if(speed == 5)         usleep(  5000);
-        else if(speed == 6)         usleep(  1000);
-        else if(speed == 7)         usleep(   500);
-        else if(speed == 8)         usleep(   100);
-        else                        /*Do nothing*/; // As fast as possible
-
-        // Handle different patterns and update grid
+        // Handle resize and input
+        #if(defined __linux__)
+            if(events[EVENT_SIGNAL].revents & POLLIN)
+            {
+                struct signalfd_siginfo info;
+                uint8_t resize = 0;
+                while(read(signal_fd, &info, sizeof(info)) == sizeof(info))
+                {
+                    if(info.ssi_signo == SIGTERM)
+                        quit();
+                    resize = 1;
+                }
+                if(resize)
+                {
+                    handle_resize();
+                    ui_dirty = 2;
+                }
+            }
+        #else
+            if(terminate)
+                quit();
+        #endif
+        if(events[EVENT_KEYS].revents & (POLLIN | POLLHUP))
+        {
+            handle_inputs();
+            ui_dirty = 2;
+        }
+        sim_set_speed(speed);
+
+        // Handle different patterns (the grid is updated by the simulation thread)
         if     (stage == STAGE_STARTUP)
         {
-            grid_init(INITPATTERN_CLEAR);
+            sim_init(INITPATTERN_CLEAR);
             stage = STAGE_STARTWAIT;
             timer = 0;
         }
@@ -859,11 +1370,12 @@ int main(int argc, char * argv[])
         {
             if(grid_too_small())
             {
-                grid_init(INITPATTERN_CLEAR);
+                if(sim_init_done())
+                    sim_init(INITPATTERN_CLEAR);
             }
             else
             {
-                grid_init(initpattern);
+                sim_init(initpattern);
                 stage = STAGE_SHOWINFO;
             }
             timer = 0;
@@ -878,11 +1390,13 @@ int main(int argc, char * argv[])
         }
         else if(stage == STAGE_RUNNING)
         {
-            if(speed > 0)
+            sim_run(1);
+            if(goto_arg != SIM_GOTO_NONE)
             {
-                grid_update();
+                sim_goto(goto_arg);
+                goto_arg = SIM_GOTO_NONE;
             }
-            if(grid_end_detected())
+            if(sim_init_done() && (frame_draw != NULL) && frame_draw->end_detected)
             {
                 stage = STAGE_END;
                 timer = 0;
@@ -890,15 +1404,16 @@ int main(int argc, char * argv[])
         }
         else if(stage == STAGE_END)
         {
-            if(speed > 0)
+            if((frame_draw != NULL) && !frame_draw->end_detected) // Gone back before the end ("b" key)
             {
-              grid_update();
+                stage = STAGE_RUNNING;
             }
-            if(timer >= TIMEOUT_END)
+            else if(timer >= TIMEOUT_END)
             {
                 if(automode == AUTOMODE_NEXT)
                 {
-                    initpattern++;
+                    if(initpattern >= INITPATTERN_CYCLEMAX) initpattern = 0;
+                    else                                    initpattern++;
                     initpattern %= INITPATTERN_CYCLEMAX;
                     stage = STAGE_INIT;
                     timer = 0;
@@ -915,28 +1430,47 @@ int main(int argc, char * argv[])
                 }
             }
         }
+        if(stage != last_stage)
+        {
+            ui_dirty = 2;
+        }
+
+        // Handle fast forward (the progress is drawn instead of the grid)
+        {
+            uint32_t last_goto_target = goto_target;
+            goto_target = sim_goto_get(&goto_reached);
+            if(goto_target != last_goto_target)
+            {
+                ui_dirty = 2;
+            }
+        }
 
         // Measure Hz
         {
             static uint16_t hz_timer = 0;
-            static uint16_t last_cycle_counter = 0;
-            uint16_t cycles = grid_get_cycle_counter() - last_cycle_counter;
+            static uint32_t last_cycle_counter = 0;
+            uint32_t cycle_counter = (frame_draw != NULL ? frame_draw->cycle_counter : 0);
+            uint32_t cycles = cycle_counter - last_cycle_counter;
             hz_timer += ticks;
+            if(speed == 0)
+            {
+                hz = 0;
+            }
             if(    ((hz_timer >=  250) && (cycles >= 50)) // Above 200 Hz 4 measurements per second
                 || ((hz_timer >=  500) && (cycles >= 10)) // Above  20 Hz 2 measurements per second
                 || ((hz_timer >= 1000) && (cycles >=  3)) // Below  20 Hz 1 measurement per second
                 ||  (hz_timer >= 2000)
               )
             {
-                if(last_cycle_counter > grid_get_cycle_counter())
+                if(last_cycle_counter > cycle_counter)
                 {
                     hz = 0;
                 }
                 else
                 {
-                    hz = (float)(cycles * 1000) / (float)hz_timer;
+                    hz = (float)cycles * 1000 / (float)hz_timer;
                 }
-                last_cycle_counter = grid_get_cycle_counter();
+                last_cycle_counter = cycle_counter;
                 hz_timer = 0;
             }
         }
@@ -949,16 +1483,14 @@ int main(int argc, char * argv[])
         #endif
 
         // Draw grid -> Reduce drawing to given Hz, because it is not necessary to draw the grid faster than the display can handle
+        // The frame timer only runs while the simulation is stepping or the screen has changed (no CPU usage while paused)
+        if(frame_timer_expired())
         {
-            #define DRAW_GRID_HZ 60
-            static uint16_t draw_timer = 0;
-            draw_timer += ticks;
-            if(draw_timer >= (1000 / DRAW_GRID_HZ))
-            {
-                draw_timer -= (1000 / DRAW_GRID_HZ);
-                tui_update();
-            }
+            tui_update();
+            if(ui_dirty > 0)
+                ui_dirty--; // Second frame for the wrefresh() of the drawn frame
         }
+        frame_timer_set(((speed > 0) && ((stage == STAGE_RUNNING) || (stage == STAGE_END))) || (goto_target != SIM_GOTO_NONE) || (ui_dirty > 0));
     }
 
     // End program
@@ -976,18 +1508,30 @@ void handle_args(int argc, char * argv[])
     {
         static struct option long_options[] =
         {
+            {"autosave",  required_argument, 0, 'a'},
             {"charstyle", required_argument, 0, 'c'},
+            {"connect",   required_argument, 0, 'C'},
+            {"direct",    no_argument,       0, 'd'},
+            {"export",    required_argument, 0, 'e'},
+            {"goto",      required_argument, 0, 'g'},
             {"help",      no_argument,       0, 'h'},
+            {"load",      required_argument, 0, 'l'},
             {"mode",      required_argument, 0, 'm'},
             {"nowait",    no_argument,       0, 'n'},
             {"pattern",   required_argument, 0, 'p'},
+            {"resume",    required_argument, 0, 'r'},
+            {"serve",     required_argument, 0, 'O'},
+            {"record",    required_argument, 0, 'R'},
+            {"replay",    required_argument, 0, 'P'},
             {"speed",     required_argument, 0, 's'},
+            {"shm",       required_argument, 0, 'S'},
             {"version",   no_argument,       0, 'v'},
+            {"window",    required_argument, 0, 'w'},
             // --------------------------------------
             {0,           0,                 0,   0}
         };
 
-        int c = getopt_long(argc, argv, "c:hm:np:s:v", long_options, 0);
+        int c = getopt_long(argc, argv, "a:c:C:de:g:hl:m:nO:p:P:r:R:s:S:vw:", long_options, 0);
 
         // Detect the end of the options
         if (c == -1)
@@ -995,6 +1539,12 @@ void handle_args(int argc, char * argv[])
 
         switch(c)
         {
+            case 'a':
+            {
+                autosave_s = atoi(optarg);
+                break;
+            }
+
             case 'c':
             {
                 charstyle = CHARSTYLE_MAX;
@@ -1017,26 +1567,56 @@ void handle_args(int argc, char * argv[])
                 break;
             }
 
+            case 'd':
+            {
+                direct_output = 1;
+                break;
+            }
+
             case 'h':
             {
                 printf("Usage:\n");
                 printf("  %s [options]\n", SW_NAME);
+                printf("  %s run [options]   Headless batch mode (see \"%s run --help\")\n", SW_NAME, SW_NAME);
+                printf("  %s search [options] Search soups with long lifespans (see \"%s search --help\")\n", SW_NAME, SW_NAME);
                 printf("\n");
                 printf("%s - ncurses Game of Life %s (compiled %s %s) by %s\n", SW_NAME, SW_VERS, __DATE__, __TIME__, AUTHOR_LONG);
                 printf("\n");
                 printf("Options:\n");
+                printf("  -a, --autosave   Autosave interval of the snapshot in seconds (0: only at the end, default 60)\n");
                 printf("  -c, --charstyle  Set character style:\n");
                 for(int i=0; i<CHARSTYLE_MAX; i++)
                     printf("                   - %-7s -> %s\n", charstyle_str[i][0], charstyle_str[i][1]);
+                printf("  -C, --connect    Show the generations of a server ([host:]port, see --serve)\n");
+                printf("  -d, --direct     Draw the grid with direct terminal output (faster on large terminals)\n");
+                printf("  -e, --export     Export the last generation as RLE file at the end of the program\n");
+                printf("  -g, --goto       Fast forward to this generation after the start (0: to the end)\n");
                 printf("  -h, --help       This Help\n");
+                printf("  -l, --load       Load initial pattern from file (RLE, plaintext or Macrocell)\n");
                 for(int i=0; i<INITPATTERN_CYCLEMAX; i++)
                     printf("                   - %-9s -> %s\n", grid_get_initpattern_short_str(i), grid_get_initpattern_long_str(i));
                 printf("  -m, --mode       Set mode:\n");
                 for(int i=0; i<MODE_MAX; i++)
                     printf("                   - %-4s -> %s\n", automode_str[i][0], automode_str[i][1]);
                 printf("  -n, --nowait     Start without Startupscreen\n");
+                printf("  -O, --serve      Stream the generations to viewers on this local port (see --connect)\n");
                 printf("  -p, --pattern    Set initial pattern:\n");
-                printf("  -s, --speed      Set speed (0-9)\n");
+                printf("  -P, --replay     Play a recording (see --record) instead of simulating\n");
+                printf("  -r, --resume     Resume from snapshot file (if it exists), save to it at the end and periodically\n");
+                printf("  -R, --record     Record all generations into a file (keyframes and deltas)\n");
+                printf("  -s, --speed      Set speed (0-%i):\n", SPEED_MAX);
+                printf("                   - 0 -> Stop\n");
+                for(int i=1; i<=SPEED_MAX; i++)
+                {
+                    if(timing_get_batch(i) > 1)
+                        printf("                   - %i -> As fast as possible in batches of %u generations, only the last one is recorded (turbo)\n", i, timing_get_batch(i));
+                    else if(timing_get_rate(i) < 0)
+                        printf("                   - %i -> As fast as possible\n", i);
+                    else
+                        printf("                   - %i -> %g Hz\n", i, timing_get_rate(i));
+                }
+                printf("  -S, --shm        Export the live grid into POSIX shared memory (e.g. /ncgol)\n");
+                printf("  -w, --window     Cycles which have to repeat for the end detection (50-%i, default %i)\n", END_DET_WINDOW_MAX, END_DET_WINDOW_DEFAULT);
                 printf("\n");
                 printf(COMMAND_KEYS_STR);
                 exit(0);
@@ -1102,9 +1682,100 @@ void handle_args(int argc, char * argv[])
                 else
                 {
                     printf("Invalid speed value: %s\n", optarg);
-                    printf("Speed must be between 0 and 9\n");
+                    printf("Speed must be between 0 and %i\n", SPEED_MAX);
+                    exit(1);
+                }
+                break;
+            }
+
+            case 'e':
+            {
+                export_path = optarg;
+                break;
+            }
+
+            case 'g':
+            {
+                char *end;
+                unsigned long val = strtoul(optarg, &end, 10);
+                if((*optarg == '\0') || (*end != '\0') || (val >= SIM_GOTO_END))
+                {
+                    printf("Invalid goto value: %s\n", optarg);
+                    exit(1);
+                }
+                goto_arg = (val > 0 ? (uint32_t)val : SIM_GOTO_END);
+                break;
+            }
+
+            case 'l':
+            {
+                if(!patfile_open(optarg))
+                {
+                    printf("Invalid pattern file: %s (%s)\n", optarg, patfile_get_error());
+                    exit(1);
+                }
+                initpattern = INITPATTERN_FILE;
+                break;
+            }
+
+            case 'r':
+            {
+                resume_path = optarg;
+                if(access(optarg, F_OK) == 0)
+                {
+                    if(!snapshot_open(optarg))
+                    {
+                        printf("Invalid snapshot file: %s (%s)\n", optarg, snapshot_get_error());
+                        exit(1);
+                    }
+                    initpattern = INITPATTERN_SNAPSHOT;
+                }
+                break;
+            }
+
+            case 'P':
+            {
+                if(!replay_open(optarg))
+                {
+                    printf("Invalid recording: %s (%s)\n", optarg, replay_get_error());
+                    exit(1);
+                }
+                initpattern = INITPATTERN_REPLAY;
+                break;
+            }
+
+            case 'R':
+            {
+                record_path = optarg;
+                break;
+            }
+
+            case 'S':
+            {
+                shm_name = optarg;
+                break;
+            }
+
+            case 'O':
+            {
+                int val = atoi(optarg);
+                if((val < 1) || (val > 65535))
+                {
+                    printf("Invalid port value: %s\n", optarg);
                     exit(1);
                 }
+                serve_port = val;
+                break;
+            }
+
+            case 'C':
+            {
+                if(!stream_connect(optarg))
+                {
+                    printf("Connection to %s failed\n", optarg);
+                    exit(1);
+                }
+                initpattern = INITPATTERN_REMOTE;
                 break;
             }
 
@@ -1114,6 +1785,22 @@ void handle_args(int argc, char * argv[])
                 exit(0);
             }
 
+            case 'w':
+            {
+                int val = atoi(optarg);
+                if((val >= 50) && (val <= END_DET_WINDOW_MAX))
+                {
+                    grid_set_window(val);
+                }
+                else
+                {
+                    printf("Invalid window value: %s\n", optarg);
+                    printf("Window must be between 50 and %i\n", END_DET_WINDOW_MAX);
+                    exit(1);
+                }
+                break;
+            }
+
             case '?': // getopt_long() already printed an error message
             default:
             {
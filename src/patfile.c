@@ -0,0 +1,561 @@
+
+// File:    patfile.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Import and export of pattern files (RLE, plaintext and Macrocell)
+//          The file is mapped into memory and parsed directly into the grid, without
+//          intermediate copies. Only the part of the pattern which fits into the grid
+//          is set, the parsing ends after the last visible row.
+//
+// Formats: https://conwaylife.com/wiki/Run_Length_Encoded
+//          https://conwaylife.com/wiki/Plaintext
+//          https://conwaylife.com/wiki/Macrocell (see macrocell.c)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "patfile.h"
+#include "grid.h"
+#include "macrocell.h"
+#include "debug_output.h"
+
+#define RLE_LINE_MAX 70 // Maximum line length for the export
+
+static patfile_format_t format = PATFILE_NONE;
+static const char *map   = NULL; // Mapped file
+static size_t   map_size = 0;
+static uint8_t  map_read = 0;    // File has been read from stdin instead of mapped
+static size_t   data_pos = 0;    // Begin of the pattern data (after the header)
+static uint32_t pat_width  = 0;
+static uint32_t pat_height = 0;
+static const char *name  = "";
+static const char *error = "";
+
+
+
+// Function to skip the rest of the line
+static size_t patfile_skip_line(size_t pos)
+{
+    const char *nl = memchr(&map[pos], '\n', map_size - pos);
+    return (nl != NULL ? (size_t)(nl - map) + 1 : map_size);
+}
+
+
+
+// Function to parse a number after the next '=' in the current line
+static uint32_t patfile_parse_value(size_t *pos)
+{
+    uint32_t val = 0;
+
+    while((*pos < map_size) && (map[*pos] != '=') && (map[*pos] != '\n'))
+        (*pos)++;
+    if((*pos < map_size) && (map[*pos] == '='))
+        (*pos)++;
+    while((*pos < map_size) && (map[*pos] == ' '))
+        (*pos)++;
+    while((*pos < map_size) && (map[*pos] >= '0') && (map[*pos] <= '9'))
+    {
+        val = val * 10 + (map[*pos] - '0');
+        (*pos)++;
+    }
+    return val;
+}
+
+
+
+// Function to check the rule of a RLE header (only Conway's Life is simulated)
+// -> "B3/S23" or "23/3" (also "S23/B3"), case-insensitive and without spaces
+// -> Returns "1" if the rule is Conway's Life
+static uint8_t patfile_check_rule(size_t pos, size_t end)
+{
+    static const char *life[] = {"b3/s23", "s23/b3", "23/3"};
+    char              rule[16];
+    uint8_t           len = 0;
+
+    while((pos < end) && (map[pos] != ',') && (map[pos] != '\r') && (map[pos] != '\n'))
+    {
+        if(map[pos] != ' ')
+        {
+            if(len >= sizeof(rule) - 1)
+                return 0;
+            rule[len++] = tolower((unsigned char)map[pos]);
+        }
+        pos++;
+    }
+    rule[len] = '\0';
+    for(uint8_t i=0; i<sizeof(life)/sizeof(life[0]); i++)
+    {
+        if(strcmp(rule, life[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+
+
+// Function to read the header of a RLE file: "x = m, y = n, rule = B3/S23"
+static uint8_t patfile_open_rle(void)
+{
+    size_t pos = 0;
+
+    // Skip comments
+    while((pos < map_size) && (map[pos] == '#'))
+        pos = patfile_skip_line(pos);
+
+    if((pos >= map_size) || (map[pos] != 'x'))
+    {
+        error = "RLE header is missing";
+        return 0;
+    }
+    pat_width  = patfile_parse_value(&pos);
+    pat_height = patfile_parse_value(&pos);
+    data_pos = patfile_skip_line(pos);
+
+    // Optional rule (default Conway's Life)
+    for(; pos + 4 <= data_pos; pos++)
+    {
+        if(strncasecmp(&map[pos], "rule", 4) == 0)
+        {
+            pos += 4;
+            while((pos < data_pos) && (map[pos] == ' '))
+                pos++;
+            if((pos < data_pos) && (map[pos] == '='))
+                pos++;
+            if(!patfile_check_rule(pos, data_pos))
+            {
+                error = "Only the rule B3/S23 (Conway's Life) is supported";
+                return 0;
+            }
+            break;
+        }
+    }
+    return 1;
+}
+
+
+
+// Function to get the size of a plaintext file (longest line and number of lines)
+static uint8_t patfile_open_plaintext(void)
+{
+    size_t pos = 0;
+
+    pat_width  = 0;
+    pat_height = 0;
+    while(pos < map_size)
+    {
+        size_t next = patfile_skip_line(pos);
+        if(map[pos] != '!') // No comment
+        {
+            uint32_t len = next - pos;
+            while((len > 0) && ((map[pos+len-1] == '\n') || (map[pos+len-1] == '\r')))
+                len--;
+            if(len > pat_width)
+                pat_width = len;
+            pat_height++;
+        }
+        pos = next;
+    }
+    data_pos = 0;
+    return 1;
+}
+
+
+
+// Function to detect the format by the content of the opened file and to read its header
+static uint8_t patfile_detect(void)
+{
+    size_t pos = 0;
+
+    while((pos < map_size) && ((map[pos] == ' ') || (map[pos] == '\r') || (map[pos] == '\n')))
+        pos++;
+    if((map_size >= 4) && (memcmp(map, "[M2]", 4) == 0))
+    {
+        format = PATFILE_MACROCELL;
+        if(macrocell_parse(map, map_size, &error))
+        {
+            // Size of the living cells (only for information, can be much bigger than the grid)
+            pat_width  = (macrocell_get_width()  > UINT32_MAX ? UINT32_MAX : macrocell_get_width());
+            pat_height = (macrocell_get_height() > UINT32_MAX ? UINT32_MAX : macrocell_get_height());
+            return 1;
+        }
+    }
+    else if((pos < map_size) && ((map[pos] == '#') || (map[pos] == 'x')))
+    {
+        format = PATFILE_RLE;
+        if(patfile_open_rle())
+            return 1;
+    }
+    else if((pos < map_size) && ((map[pos] == '!') || (map[pos] == '.') || (map[pos] == 'O') || (map[pos] == '*')))
+    {
+        format = PATFILE_PLAINTEXT;
+        if(patfile_open_plaintext())
+            return 1;
+    }
+    else
+    {
+        error = "Unknown file format";
+    }
+
+    if(map_read)
+        free((void *)map);
+    else
+        munmap((void *)map, map_size);
+    map    = NULL;
+    format = PATFILE_NONE;
+    return 0;
+}
+
+
+
+// Function to read the whole pattern from stdin (a pipe can not be mapped)
+static uint8_t patfile_read_stdin(void)
+{
+    size_t size = 0;
+    size_t len  = 0;
+    char   *buf = NULL;
+
+    while(1)
+    {
+        if(len == size)
+        {
+            size = (size > 0 ? size * 2 : 64 * 1024);
+            buf  = realloc(buf, size);
+            if(buf == NULL)
+            {
+                exit(1);
+            }
+        }
+        ssize_t ret = read(STDIN_FILENO, &buf[len], size - len);
+        if(ret <= 0)
+            break;
+        len += ret;
+    }
+    if(len == 0)
+    {
+        free(buf);
+        error = "File is empty";
+        return 0;
+    }
+    map      = buf;
+    map_size = len;
+    map_read = 1;
+    return 1;
+}
+
+
+
+// Open a pattern file (the file stays mapped into memory for every restart of the pattern)
+// -> The path "-" reads the pattern from stdin
+// -> Returns "1" if the file could be opened, otherwise see patfile_get_error()
+uint8_t patfile_open(const char * path)
+{
+    struct stat st;
+    int fd;
+
+    if(strcmp(path, "-") == 0)
+    {
+        if(!patfile_read_stdin())
+        {
+            return 0;
+        }
+        name = "stdin";
+        return patfile_detect();
+    }
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        error = "File can not be opened";
+        return 0;
+    }
+    if((fstat(fd, &st) != 0) || (st.st_size == 0))
+    {
+        error = "File is empty";
+        close(fd);
+        return 0;
+    }
+    map_size = st.st_size;
+    map      = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        map   = NULL;
+        error = "File can not be mapped";
+        return 0;
+    }
+    madvise((void *)map, map_size, MADV_SEQUENTIAL);
+    map_read = 0;
+
+    name = strrchr(path, '/');
+    name = (name != NULL ? name + 1 : path);
+    return patfile_detect();
+}
+
+
+
+// Get the reason why the pattern file could not be opened
+const char * patfile_get_error(void)
+{
+    return error;
+}
+
+
+
+// Get the name of the opened pattern file (without path)
+const char * patfile_get_name(void)
+{
+    return name;
+}
+
+
+
+// Get the width of the pattern in the file
+uint32_t patfile_get_width(void)
+{
+    return pat_width;
+}
+
+
+
+// Get the height of the pattern in the file
+uint32_t patfile_get_height(void)
+{
+    return pat_height;
+}
+
+
+
+// Function to set a horizontal run of living cells (clipped to the grid)
+static inline void patfile_set_run(grid_t * grid, int64_t x, int64_t y, uint32_t cnt)
+{
+    int64_t x_end = x + cnt;
+
+    if((y < 0) || (y >= grid_get_height()))
+        return;
+    if(x < 0)
+        x = 0;
+    if(x_end > grid_get_width())
+        x_end = grid_get_width();
+    for(; x<x_end; x++)
+        grid[x][y] = 1;
+}
+
+
+
+// Function to parse the RLE data into the grid (pattern position: x_off, y_off)
+static void patfile_parse_rle(grid_t * grid, int64_t x_off, int64_t y_off)
+{
+    const char *p   = &map[data_pos];
+    const char *end = &map[map_size];
+    int64_t  x   = x_off;
+    int64_t  y   = y_off;
+    uint32_t cnt = 0;
+
+    while(p < end)
+    {
+        // Rows above the grid -> Only search for the end of the row
+        if((y < 0) && (cnt == 0) && (x == x_off))
+        {
+            const char *row_end = memchr(p, '$', end - p);
+            if((row_end == NULL) || (memchr(p, '!', row_end - p) != NULL))
+                break;
+            const char *num = row_end;
+            while((num > p) && (num[-1] >= '0') && (num[-1] <= '9'))
+                num--;
+            p = num;
+            x = x_off + 1; // Parse the count and '$' below
+        }
+
+        char c = *p++;
+        if((c >= '0') && (c <= '9'))
+        {
+            cnt = cnt * 10 + (c - '0');
+            continue;
+        }
+        if((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n'))  // Whitespace
+        {
+            continue;
+        }
+        if(cnt == 0)
+            cnt = 1;
+
+        if((c == 'b') || (c == '.'))                             // Dead cells
+        {
+            x += cnt;
+        }
+        else if(c == '$')                                        // End of row(s)
+        {
+            x  = x_off;
+            y += cnt;
+            if(y >= grid_get_height())                           // Rest of the pattern is not visible
+                break;
+        }
+        else if(c == '!')                                        // End of pattern
+        {
+            break;
+        }
+        else if(((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z'))) // Living cells ("o" or any other state)
+        {
+            patfile_set_run(grid, x, y, cnt);
+            x += cnt;
+        }
+        else if(c == '#')                                        // Comment inside the data
+        {
+            p = memchr(p, '\n', end - p);
+            if(p == NULL)
+                break;
+        }
+        cnt = 0;
+    }
+}
+
+
+
+// Function to parse the plaintext data into the grid (pattern position: x_off, y_off)
+static void patfile_parse_plaintext(grid_t * grid, int64_t x_off, int64_t y_off)
+{
+    const char *p   = &map[data_pos];
+    const char *end = &map[map_size];
+    int64_t  x = x_off;
+    int64_t  y = y_off;
+
+    while((p < end) && (y < grid_get_height()))
+    {
+        if((x == x_off) && (*p == '!'))                          // Comment line
+        {
+            p = memchr(p, '\n', end - p);
+            if(p == NULL)
+                break;
+            p++;
+            continue;
+        }
+
+        char c = *p++;
+        if(c == '\n')
+        {
+            x = x_off;
+            y++;
+        }
+        else if((c == 'O') || (c == '*'))
+        {
+            patfile_set_run(grid, x, y, 1);
+            x++;
+        }
+        else if(c != '\r')
+        {
+            x++;
+        }
+    }
+}
+
+
+
+// Set the pattern of the file to the grid center (parsed directly from the file into the grid)
+void patfile_set_to_center(grid_t * grid)
+{
+    // Check for null-pointer
+    if((grid == 0) || (map == NULL))
+    {
+        return;
+    }
+
+    // Calculate center position (patterns bigger than the grid are cut on all sides)
+    int64_t x_off = ((int64_t)grid_get_width()  - pat_width)  / 2;
+    int64_t y_off = ((int64_t)grid_get_height() - pat_height) / 2;
+
+    #if (WITH_DEBUG_OUTPUT)
+        debug_time_start(DEBUG_TIME3);
+    #endif
+    if(format == PATFILE_RLE)
+        patfile_parse_rle(grid, x_off, y_off);
+    else if(format == PATFILE_PLAINTEXT)
+        patfile_parse_plaintext(grid, x_off, y_off);
+    else if(format == PATFILE_MACROCELL)
+        macrocell_set_to_center(grid);
+    #if (WITH_DEBUG_OUTPUT)
+        debug_time_stop(DEBUG_TIME3);
+        debug_printf("Pattern file %s (%ux%u) parsed in %u us\n", name, pat_width, pat_height, debug_time_get(DEBUG_TIME3));
+    #endif
+}
+
+
+
+// Function to write a run of cells into the RLE file (with line wrapping)
+static void patfile_write_run(FILE * file, uint32_t cnt, char tag, uint8_t * line_len)
+{
+    char str[16];
+    int  len;
+
+    if(cnt == 0)
+        return;
+    else if(cnt == 1)
+        len = sprintf(str, "%c", tag);
+    else
+        len = sprintf(str, "%u%c", cnt, tag);
+
+    if(*line_len + len > RLE_LINE_MAX)
+    {
+        fputc('\n', file);
+        *line_len = 0;
+    }
+    fputs(str, file);
+    *line_len += len;
+}
+
+
+
+// Save a generation as RLE file
+// -> The path "-" writes to stdout
+// -> Returns "1" if the file has been written
+uint8_t patfile_save_rle(const char * path, const grid_t * cells, uint16_t width, uint16_t height, uint32_t generation)
+{
+    FILE    *file = (strcmp(path, "-") == 0 ? stdout : fopen(path, "w"));
+    uint8_t  line_len  = 0;
+    uint32_t rows_open = 0; // Rows which are finished, but not written yet ("$")
+
+    if(file == NULL)
+    {
+        return 0;
+    }
+
+    fprintf(file, "#N %s\n", path);
+    fprintf(file, "#C Generation %u, exported by ncgol\n", generation);
+    fprintf(file, "x = %u, y = %u, rule = B3/S23\n", width, height);
+
+    for(uint16_t y=0; y<height; y++)
+    {
+        uint16_t x = 0;
+        while(x < width)
+        {
+            uint8_t  state = cells[x][y];
+            uint16_t run   = 0;
+            while((x < width) && (cells[x][y] == state))
+            {
+                x++;
+                run++;
+            }
+            if((x == width) && (state == 0))                     // Dead cells at the end of the row are not written
+                break;
+            patfile_write_run(file, rows_open, '$', &line_len);
+            rows_open = 0;
+            patfile_write_run(file, run, (state ? 'o' : 'b'), &line_len);
+        }
+        rows_open++;
+    }
+    patfile_write_run(file, 1, '!', &line_len);
+    fputc('\n', file);
+
+    if(file == stdout)
+    {
+        return (fflush(file) == 0);
+    }
+    return (fclose(file) == 0);
+}
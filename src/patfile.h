@@ -0,0 +1,52 @@
+
+// File:    patfile.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Import and export of pattern files (RLE, plaintext and Macrocell)
+
+#ifndef __PATFILE_H
+#define __PATFILE_H
+
+#include <stdint.h>
+#include "grid.h"
+
+typedef enum
+{
+    PATFILE_NONE,
+    PATFILE_RLE,       // Run length encoded (*.rle)
+    PATFILE_PLAINTEXT, // Plaintext (*.cells)
+    PATFILE_MACROCELL, // Macrocell quadtree (*.mc)
+    // ----------------
+    PATFILE_MAX
+} patfile_format_t;
+
+
+
+// Open a pattern file (the file stays mapped into memory for every restart of the pattern)
+// -> The path "-" reads the pattern from stdin
+// -> Returns "1" if the file could be opened, otherwise see patfile_get_error()
+uint8_t patfile_open(const char * path);
+
+// Get the reason why the pattern file could not be opened
+const char * patfile_get_error(void);
+
+// Get the name of the opened pattern file (without path)
+const char * patfile_get_name(void);
+
+// Get the width of the pattern in the file
+uint32_t patfile_get_width(void);
+
+// Get the height of the pattern in the file
+uint32_t patfile_get_height(void);
+
+// Set the pattern of the file to the grid center (parsed directly from the file into the grid)
+void patfile_set_to_center(grid_t * grid);
+
+// Save a generation as RLE file
+// -> The path "-" writes to stdout
+// -> Returns "1" if the file has been written
+uint8_t patfile_save_rle(const char * path, const grid_t * cells, uint16_t width, uint16_t height, uint32_t generation);
+
+
+
+#endif // __PATFILE_H
@@ -0,0 +1,453 @@
+
+// File:    recorder.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Recording of the generations into a file (keyframes and deltas).
+//          Every generation is stored as XOR of the packed grid to the last recorded one.
+//          Only the runs of changed bytes are written, so the size of a generation depends
+//          on the activity and not on the size of the grid. Every RECORDER_KEYFRAME
+//          generations a keyframe (delta to an empty grid) is written, so a replay can
+//          start there without reading the whole file.
+//          The simulation thread only packs the grid into one of two buffers. The encoding
+//          and the writing are done by the writer thread. If both buffers are still in use,
+//          the generation is skipped instead of waiting for the writer (the next delta is
+//          still correct, it is calculated to the last recorded generation). Every record
+//          has its generation, so a replay shows the gap. The number of skipped generations
+//          is shown in the status line and at the end of the program.
+//          The recording is stopped at the first write error (e.g. a full disk), which is also
+//          shown in the status line and at the end of the program.
+//          When the recording is closed, an index of the keyframes is appended, so a replay
+//          can seek without reading the file (see replay.c).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "config.h"
+#include "recorder.h"
+#include "grid.h"
+#include "debug_output.h"
+
+#define RECORDER_GAP_MIN 4 // Unchanged bytes which end a run (shorter gaps are written within the run)
+
+typedef enum
+{
+    SLOT_FREE,             // Can be filled by the simulation thread
+    SLOT_FILLING,          // Simulation thread packs the grid
+    SLOT_FULL              // Waits for the writer thread
+} slot_state_t;
+
+typedef struct
+{
+    uint8_t      *bits;    // Packed grid
+    uint32_t     generation;
+    uint16_t     width;
+    uint16_t     height;
+    slot_state_t state;
+} recorder_slot_t;
+
+static FILE            *file = NULL;
+static pthread_t       writer;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  cond  = PTHREAD_COND_INITIALIZER;
+static recorder_slot_t slots[2];
+static uint8_t         fill_idx  = 0; // Next slot for the simulation thread
+static uint8_t         recording = 0;
+static uint8_t         stop      = 0;
+static uint32_t        skipped   = 0; // Generations which have been skipped because of a busy writer
+static int             write_errno = 0; // Error of the first failed write (0: No error)
+
+
+
+// Function to write a variable length number (7 bits per byte, LSB first)
+static uint32_t recorder_put_varint(uint8_t * out, uint32_t val)
+{
+    uint32_t len = 0;
+
+    while(val >= 0x80)
+    {
+        out[len++] = (val & 0x7F) | 0x80;
+        val >>= 7;
+    }
+    out[len++] = val;
+    return len;
+}
+
+
+
+// Function to read a variable length number of a run
+static uint8_t recorder_get_varint(const uint8_t ** p, const uint8_t * end, uint32_t * val)
+{
+    uint8_t shift = 0;
+
+    *val = 0;
+    while((*p < end) && (shift < 32))
+    {
+        uint8_t byte = *(*p)++;
+        *val |= (uint32_t)(byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+            return 1;
+        shift += 7;
+    }
+    return 0;
+}
+
+
+
+// Encode the runs of changed bytes between two packed grids (prev NULL: empty grid)
+// -> "out" needs RECORDER_RUNS_MAX(size) bytes
+// -> Returns the size of the runs in "out"
+uint32_t recorder_encode_runs(const uint8_t * cur, const uint8_t * prev, uint32_t size, uint8_t * out)
+{
+    uint32_t pos  = 0;
+    uint32_t last = 0; // End of the last run
+    uint32_t len  = 0;
+
+    #define CHANGED(i) (cur[i] != (prev != NULL ? prev[i] : 0))
+
+    while(pos < size)
+    {
+        // Skip unchanged bytes (8 bytes at once)
+        while(pos + 8 <= size)
+        {
+            uint64_t c, p = 0;
+            memcpy(&c, &cur[pos], 8);
+            if(prev != NULL)
+                memcpy(&p, &prev[pos], 8);
+            if(c != p)
+                break;
+            pos += 8;
+        }
+        while((pos < size) && !CHANGED(pos))
+            pos++;
+        if(pos >= size)
+            break;
+
+        // Find the end of the run (short gaps are included)
+        uint32_t end = pos + 1;
+        while(end < size)
+        {
+            if(CHANGED(end))
+            {
+                end++;
+                continue;
+            }
+            uint32_t gap = end;
+            while((gap < size) && !CHANGED(gap) && (gap - end < RECORDER_GAP_MIN))
+                gap++;
+            if((gap == size) || !CHANGED(gap))
+                break;
+            end = gap;
+        }
+
+        len += recorder_put_varint(&out[len], pos - last);
+        len += recorder_put_varint(&out[len], end - pos);
+        for(uint32_t i=pos; i<end; i++)
+            out[len++] = cur[i] ^ (prev != NULL ? prev[i] : 0);
+        last = end;
+        pos  = end;
+    }
+    #undef CHANGED
+
+    return len;
+}
+
+
+
+// Apply encoded runs to a packed grid (XOR, invalid runs are ignored)
+void recorder_apply_runs(uint8_t * bits, uint32_t size, const uint8_t * runs, uint32_t runs_size)
+{
+    const uint8_t *p   = runs;
+    const uint8_t *end = runs + runs_size;
+    uint32_t      pos  = 0;
+
+    while(p < end)
+    {
+        uint32_t skip, len;
+        if(    !recorder_get_varint(&p, end, &skip) || !recorder_get_varint(&p, end, &len)
+            || ((uint64_t)pos + skip + len > size) || (len > (uint32_t)(end - p))
+          )
+        {
+            break;
+        }
+        pos += skip;
+        for(uint32_t i=0; i<len; i++)
+            bits[pos++] ^= p[i];
+        p += len;
+    }
+}
+
+
+
+// Function to stop the recording because of a write error (keeps the first error)
+static void recorder_fail(void)
+{
+    int err = (errno != 0 ? errno : EIO);
+
+    pthread_mutex_lock(&mutex);
+    if(write_errno == 0)
+        write_errno = err;
+    pthread_mutex_unlock(&mutex);
+}
+
+
+
+// Function to write the index of the keyframes and the trailer at the end of the recording
+// -> Returns "1" if everything has been written
+static uint8_t recorder_write_index(const recorder_index_t * index, uint32_t keys, uint64_t offset, uint32_t frames)
+{
+    recorder_record_t       record;
+    recorder_file_trailer_t trailer;
+
+    memset(&record, 0, sizeof(record));
+    record.type = RECORDER_TYPE_INDEX;
+    record.size = keys * sizeof(index[0]);
+
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.index_offset = offset;
+    trailer.frames       = frames;
+    memcpy(trailer.magic, RECORDER_TRAILER_MAGIC, sizeof(trailer.magic));
+
+    return (    (fwrite(&record, sizeof(record), 1, file) == 1)
+             && (fwrite(index, sizeof(index[0]), keys, file) == keys)
+             && (fwrite(&trailer, sizeof(trailer), 1, file) == 1)
+           );
+}
+
+
+
+// Writer thread (encodes and writes the generations of the full slots)
+static void * recorder_writer(void * args)
+{
+    uint8_t  *prev = malloc(GRID_PACKED_SIZE(GRID_WIDTH_MAX, GRID_HEIGHT_MAX));
+    uint8_t  *out  = malloc(RECORDER_RUNS_MAX(GRID_PACKED_SIZE(GRID_WIDTH_MAX, GRID_HEIGHT_MAX)));
+    uint8_t  write_idx   = 0;
+    uint8_t  first       = 1;
+    uint32_t key_gen     = 0; // Generation of the last keyframe
+    uint64_t offset      = sizeof(recorder_file_header_t); // Offset of the next record
+    uint32_t frames      = 0;
+    recorder_index_t *index = NULL;
+    uint32_t keys        = 0;
+    uint32_t keys_size   = 0;
+    recorder_record_t record;
+
+    (void)args;
+    if((prev == NULL) || (out == NULL))
+    {
+        exit(1);
+    }
+    memset(&record, 0, sizeof(record));
+
+    while(1)
+    {
+        recorder_slot_t *slot = &slots[write_idx];
+
+        // Wait for the next generation (the full slots are written also after the stop)
+        pthread_mutex_lock(&mutex);
+        while((slot->state != SLOT_FULL) && !stop)
+            pthread_cond_wait(&cond, &mutex);
+        pthread_mutex_unlock(&mutex);
+        if(slot->state != SLOT_FULL)
+            break;
+
+        // New keyframe for the first generation, a new pattern, a new grid size or after the interval
+        uint8_t key = (    first
+                        || (slot->generation <= record.generation)
+                        || (slot->width  != record.width)
+                        || (slot->height != record.height)
+                        || (slot->generation - key_gen >= RECORDER_KEYFRAME)
+                      );
+        if(key)
+        {
+            key_gen = slot->generation;
+            if(keys == keys_size)
+            {
+                keys_size = (keys_size > 0 ? keys_size * 2 : 256);
+                index     = realloc(index, keys_size * sizeof(index[0]));
+                if(index == NULL)
+                {
+                    exit(1);
+                }
+            }
+            index[keys].offset   = offset;
+            index[keys].frame    = frames;
+            index[keys].reserved = 0;
+            keys++;
+        }
+        first = 0;
+
+        record.generation = slot->generation;
+        record.width      = slot->width;
+        record.height     = slot->height;
+        record.type       = (key ? RECORDER_TYPE_KEYFRAME : RECORDER_TYPE_DELTA);
+        record.size       = recorder_encode_runs(slot->bits, (key ? NULL : prev), GRID_PACKED_SIZE(slot->width, slot->height), out);
+        errno = 0;
+        if(    (fwrite(&record, sizeof(record), 1, file) != 1)
+            || (fwrite(out, 1, record.size, file) != record.size)
+            || (key && (fflush(file) != 0))
+          )
+        {
+            // Write error -> Stop the recording (the simulation goes on)
+            recorder_fail();
+            break;
+        }
+        offset += sizeof(record) + record.size;
+        frames++;
+
+        // The packed grid is the base for the next delta -> Swap the buffers
+        uint8_t *bits = slot->bits;
+        slot->bits = prev;
+        prev       = bits;
+
+        pthread_mutex_lock(&mutex);
+        slot->state = SLOT_FREE;
+        pthread_mutex_unlock(&mutex);
+        write_idx ^= 1;
+    }
+
+    errno = 0;
+    if((recorder_get_error() == NULL) && !recorder_write_index(index, keys, offset, frames))
+    {
+        recorder_fail();
+    }
+    #if (WITH_DEBUG_OUTPUT)
+        debug_printf("Recorded %u generations with %llu bytes (%u skipped)\n", frames, (unsigned long long)offset, skipped);
+    #endif
+    free(prev);
+    free(out);
+    free(index);
+    return NULL;
+}
+
+
+
+// Open a file for the recording and start the writer thread
+// -> Returns "1" if the file could be opened
+uint8_t recorder_open(const char * path)
+{
+    recorder_file_header_t header;
+
+    file = fopen(path, "wb");
+    if(file == NULL)
+    {
+        return 0;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDER_MAGIC, sizeof(header.magic));
+    header.version  = RECORDER_VERSION;
+    header.keyframe = RECORDER_KEYFRAME;
+    if(fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        fclose(file);
+        return 0;
+    }
+
+    for(uint8_t i=0; i<2; i++)
+    {
+        slots[i].bits  = malloc(GRID_PACKED_SIZE(GRID_WIDTH_MAX, GRID_HEIGHT_MAX));
+        slots[i].state = SLOT_FREE;
+        if(slots[i].bits == NULL)
+        {
+            exit(1);
+        }
+    }
+    if(pthread_create(&writer, NULL, recorder_writer, NULL))
+    {
+        exit(1);
+    }
+    recording = 1;
+    return 1;
+}
+
+
+
+// Add a generation to the recording (only for the simulation thread, never waits for the writer)
+// -> A new keyframe is written for a new pattern ("generation" 0) or a new grid size
+// -> If the writer is still busy with the last two generations, this one is skipped
+void recorder_add(const grid_t * grid, uint16_t width, uint16_t height, uint32_t generation)
+{
+    recorder_slot_t *slot = &slots[fill_idx];
+
+    if(!recording)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&mutex);
+    if(write_errno != 0)
+    {
+        // Recording has been stopped because of a write error
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+    if(stop || (slot->state != SLOT_FREE))
+    {
+        skipped++;
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+    slot->state = SLOT_FILLING;
+    pthread_mutex_unlock(&mutex);
+
+    grid_pack(grid, width, height, slot->bits);
+    slot->generation = generation;
+    slot->width      = width;
+    slot->height     = height;
+
+    pthread_mutex_lock(&mutex);
+    slot->state = SLOT_FULL;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+    fill_idx ^= 1;
+}
+
+
+
+// Return the number of generations which have been skipped because of a busy writer
+uint32_t recorder_get_skipped(void)
+{
+    uint32_t cnt;
+
+    pthread_mutex_lock(&mutex);
+    cnt = skipped;
+    pthread_mutex_unlock(&mutex);
+    return cnt;
+}
+
+
+
+// Return the reason why the recording has been stopped (NULL: No write error)
+const char * recorder_get_error(void)
+{
+    int err;
+
+    pthread_mutex_lock(&mutex);
+    err = write_errno;
+    pthread_mutex_unlock(&mutex);
+    return (err != 0 ? strerror(err) : NULL);
+}
+
+
+
+// Write the pending generations and the index of the keyframes and close the recording
+void recorder_close(void)
+{
+    if(!recording)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&mutex);
+    stop = 1;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(writer, NULL);
+
+    errno = 0;
+    if(fclose(file) != 0)
+    {
+        recorder_fail();
+    }
+}
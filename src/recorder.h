@@ -0,0 +1,96 @@
+
+// File:    recorder.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Recording of the generations into a file (keyframes and deltas)
+
+#ifndef __RECORDER_H
+#define __RECORDER_H
+
+#include <stdint.h>
+#include "grid.h"
+
+#define RECORDER_MAGIC    "NCGOLREC"
+#define RECORDER_VERSION  1
+#define RECORDER_KEYFRAME 1000 // Generations between two keyframes
+
+// Header at the beginning of a recording
+typedef struct
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t keyframe;      // Generations between two keyframes
+} recorder_file_header_t;
+
+// Header of every generation in a recording, followed by "size" bytes of runs:
+// -> Bytes to skip (varint), bytes of the run (varint), XOR of the packed grid (see grid_pack())
+// -> A keyframe is a delta to an empty grid, a delta is the change to the last recorded generation
+typedef struct
+{
+    uint32_t generation;    // Generations since the initialization of the pattern
+    uint16_t width;
+    uint16_t height;
+    uint32_t size;          // Size of the runs in bytes
+    uint8_t  type;          // RECORDER_TYPE_KEYFRAME or RECORDER_TYPE_DELTA
+    uint8_t  reserved[3];
+} recorder_record_t;
+
+#define RECORDER_TYPE_KEYFRAME 'K'
+#define RECORDER_TYPE_DELTA    'D'
+#define RECORDER_TYPE_INDEX    'I' // Index of the keyframes (written when the recording is closed)
+
+// Entry of the keyframe index (the frames of a recording are numbered in the order of the records)
+typedef struct
+{
+    uint64_t offset;        // Offset of the keyframe record in the file
+    uint32_t frame;
+    uint32_t reserved;
+} recorder_index_t;
+
+// Trailer at the end of a closed recording (a recording without trailer is still readable)
+#define RECORDER_TRAILER_MAGIC "NCGOLIDX"
+typedef struct
+{
+    uint64_t index_offset;  // Offset of the index record
+    uint32_t frames;        // Number of recorded frames
+    uint32_t reserved;
+    char     magic[8];
+} recorder_file_trailer_t;
+
+
+
+// Maximum size of the runs for a packed grid of "size" bytes
+#define RECORDER_RUNS_MAX(size) (2 * (size) + 16)
+
+
+
+// Encode the runs of changed bytes between two packed grids (prev NULL: empty grid)
+// -> "out" needs RECORDER_RUNS_MAX(size) bytes
+// -> Returns the size of the runs in "out"
+uint32_t recorder_encode_runs(const uint8_t * cur, const uint8_t * prev, uint32_t size, uint8_t * out);
+
+// Apply encoded runs to a packed grid (XOR, invalid runs are ignored)
+void recorder_apply_runs(uint8_t * bits, uint32_t size, const uint8_t * runs, uint32_t runs_size);
+
+// Open a file for the recording and start the writer thread
+// -> Returns "1" if the file could be opened
+uint8_t recorder_open(const char * path);
+
+// Add a generation to the recording (only for the simulation thread, never waits for the writer)
+// -> A new keyframe is written for a new pattern ("generation" 0) or a new grid size
+// -> If the writer is still busy with the last two generations, this one is skipped
+void recorder_add(const grid_t * grid, uint16_t width, uint16_t height, uint32_t generation);
+
+// Return the number of generations which have been skipped because of a busy writer
+uint32_t recorder_get_skipped(void);
+
+// Return the reason why the recording has been stopped (NULL: No write error)
+// -> The recording is stopped at the first write error, the simulation goes on
+const char * recorder_get_error(void);
+
+// Write the pending generations and the index of the keyframes and close the recording
+void recorder_close(void);
+
+
+
+#endif // __RECORDER_H
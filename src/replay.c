@@ -0,0 +1,399 @@
+
+// File:    replay.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Replay of recorded runs (see recorder.h).
+//          The recording is mapped into memory, so also very big files are opened at once.
+//          The keyframes are taken from the index at the end of the file (only a recording
+//          which has not been closed correctly is scanned record by record).
+//          The frames between two keyframes are a segment. For the current segment the
+//          offsets of its records are collected, then every frame is reached from the
+//          current one: Forward by applying the next deltas, backward by applying the
+//          deltas again (XOR) or from the keyframe, whichever is shorter.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "replay.h"
+#include "recorder.h"
+#include "grid.h"
+#include "debug_output.h"
+
+static const uint8_t  *map = NULL;  // Mapped recording
+static size_t         map_size = 0;
+static const char     *name  = "";
+static const char     *error = "";
+static recorder_index_t *keys = NULL;
+static uint32_t       keys_cnt = 0;
+static uint32_t       keys_size = 0;
+static uint32_t       frames   = 0;
+static uint32_t       keyframe = RECORDER_KEYFRAME;
+
+// Current segment and frame
+static uint32_t       seg      = UINT32_MAX;
+static uint64_t       *seg_offs = NULL; // Offsets of the records in the segment
+static uint32_t       seg_len  = 0;
+static uint32_t       seg_size = 0;
+static uint32_t       frame    = 0;
+static recorder_record_t cur;           // Record of the current frame
+static uint8_t        bits[GRID_PACKED_SIZE(GRID_WIDTH_MAX, GRID_HEIGHT_MAX)]; // Packed grid of the current frame
+
+
+
+// Function to read the header of a frame record (keyframe or delta)
+// -> Returns "1" if the record is complete
+static uint8_t replay_read_record(uint64_t offset, recorder_record_t * record)
+{
+    if(offset + sizeof(*record) > map_size)
+    {
+        return 0;
+    }
+    memcpy(record, &map[offset], sizeof(*record));
+    return (    (offset + sizeof(*record) + record->size <= map_size)
+             && ((record->type == RECORDER_TYPE_KEYFRAME) || (record->type == RECORDER_TYPE_DELTA))
+             && (record->width <= GRID_WIDTH_MAX) && (record->height <= GRID_HEIGHT_MAX)
+           );
+}
+
+
+
+// Function to add a keyframe to the index
+static void replay_add_key(uint64_t offset, uint32_t frame)
+{
+    if(keys_cnt == keys_size)
+    {
+        keys_size = (keys_size > 0 ? keys_size * 2 : 256);
+        keys      = realloc(keys, keys_size * sizeof(keys[0]));
+        if(keys == NULL)
+        {
+            exit(1);
+        }
+    }
+    keys[keys_cnt].offset = offset;
+    keys[keys_cnt].frame  = frame;
+    keys_cnt++;
+}
+
+
+
+// Function to read the index of the keyframes from the end of the file
+// -> Returns "1" if the recording has been closed with a valid index
+// -> The frames of the keyframes have to increase and the offsets have to point to keyframes,
+//    otherwise the index is not used (the recording is scanned like one without index)
+static uint8_t replay_read_index(void)
+{
+    recorder_file_trailer_t trailer;
+    recorder_record_t       record;
+
+    if(map_size < sizeof(recorder_file_header_t) + sizeof(record) + sizeof(trailer))
+    {
+        return 0;
+    }
+    memcpy(&trailer, &map[map_size - sizeof(trailer)], sizeof(trailer));
+    if(    (memcmp(trailer.magic, RECORDER_TRAILER_MAGIC, sizeof(trailer.magic)) != 0)
+        || (trailer.index_offset > map_size - sizeof(trailer) - sizeof(record))
+        || (trailer.frames > map_size / sizeof(record))                                 // Every frame has at least its record
+      )
+    {
+        return 0;
+    }
+    memcpy(&record, &map[trailer.index_offset], sizeof(record));
+    if(    (record.type != RECORDER_TYPE_INDEX)
+        || (trailer.index_offset + sizeof(record) + record.size != map_size - sizeof(trailer))
+        || ((record.size % sizeof(keys[0])) != 0)
+      )
+    {
+        return 0;
+    }
+
+    keys_cnt = record.size / sizeof(keys[0]);
+    keys     = malloc(record.size + sizeof(keys[0]));
+    if(keys == NULL)
+    {
+        exit(1);
+    }
+    memcpy(keys, &map[trailer.index_offset + sizeof(record)], record.size);
+    for(uint32_t i=0; i<keys_cnt; i++)
+    {
+        recorder_record_t key;
+        if(    (keys[i].frame >= trailer.frames)
+            || ((i > 0) && (keys[i].frame <= keys[i-1].frame))
+            || (keys[i].offset < sizeof(recorder_file_header_t))
+            || (keys[i].offset >= trailer.index_offset)
+            || !replay_read_record(keys[i].offset, &key)
+            || (key.type != RECORDER_TYPE_KEYFRAME)
+          )
+        {
+            free(keys);
+            keys     = NULL;
+            keys_cnt = 0;
+            return 0;
+        }
+    }
+    frames = trailer.frames;
+    return 1;
+}
+
+
+
+// Function to collect the keyframes by reading all records (recording without index)
+static void replay_scan(void)
+{
+    uint64_t          offset = sizeof(recorder_file_header_t);
+    recorder_record_t record;
+
+    frames = 0;
+    while(replay_read_record(offset, &record))
+    {
+        if(record.type == RECORDER_TYPE_KEYFRAME)
+            replay_add_key(offset, frames);
+        else if(keys_cnt == 0) // Delta without keyframe
+            break;
+        offset += sizeof(record) + record.size;
+        frames++;
+    }
+}
+
+
+
+// Open a recording (the file is mapped into memory, only the records which are needed are read)
+// -> Returns "1" if the file is a valid recording, otherwise see replay_get_error()
+uint8_t replay_open(const char * path)
+{
+    struct stat st;
+    recorder_file_header_t header;
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0)
+    {
+        error = "File can not be opened";
+        return 0;
+    }
+    if((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(header)))
+    {
+        error = "File is too small";
+        close(fd);
+        return 0;
+    }
+    map_size = st.st_size;
+    map      = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        map   = NULL;
+        error = "File can not be mapped";
+        return 0;
+    }
+
+    memcpy(&header, map, sizeof(header));
+    if((memcmp(header.magic, RECORDER_MAGIC, sizeof(header.magic)) != 0) || (header.version != RECORDER_VERSION))
+    {
+        error = "No recording of this version";
+    }
+    else
+    {
+        keyframe = header.keyframe;
+        if(!replay_read_index())
+        {
+            replay_scan();
+        }
+        if((keys_cnt > 0) && (keys[0].frame == 0) && (frames > 0))
+        {
+            name = strrchr(path, '/');
+            name = (name != NULL ? name + 1 : path);
+            seg  = UINT32_MAX;
+            replay_seek(0);
+            return 1;
+        }
+        error = "No frames";
+    }
+
+    munmap((void *)map, map_size);
+    map = NULL;
+    return 0;
+}
+
+
+
+// Return "1" if a recording is opened
+uint8_t replay_is_open(void)
+{
+    return (map != NULL);
+}
+
+
+
+// Get the reason why the recording could not be opened
+const char * replay_get_error(void)
+{
+    return error;
+}
+
+
+
+// Get the name of the opened recording (without path)
+const char * replay_get_name(void)
+{
+    return name;
+}
+
+
+
+// Get the number of frames in the recording
+uint32_t replay_get_frames(void)
+{
+    return frames;
+}
+
+
+
+// Get the number of frames between two keyframes
+uint32_t replay_get_keyframe(void)
+{
+    return keyframe;
+}
+
+
+
+// Get the current frame
+uint32_t replay_get_frame(void)
+{
+    return frame;
+}
+
+
+
+// Get the generation of the current frame
+uint32_t replay_get_generation(void)
+{
+    return cur.generation;
+}
+
+
+
+// Function to apply the runs of a record to the packed grid (keyframe: set, delta: XOR)
+static void replay_apply(uint64_t offset)
+{
+    recorder_record_t record;
+    uint32_t          size;
+
+    memcpy(&record, &map[offset], sizeof(record));
+    size = GRID_PACKED_SIZE(record.width, record.height);
+    if(record.type == RECORDER_TYPE_KEYFRAME)
+    {
+        memset(bits, 0, size);
+    }
+    recorder_apply_runs(bits, size, &map[offset + sizeof(record)], record.size);
+    cur = record;
+}
+
+
+
+// Function to collect the records of a segment and apply its keyframe
+// -> Returns "1" if the segment has at least its keyframe
+static uint8_t replay_load_segment(uint32_t s)
+{
+    uint32_t          len    = (s + 1 < keys_cnt ? keys[s+1].frame : frames) - keys[s].frame;
+    uint64_t          offset = keys[s].offset;
+    recorder_record_t record;
+
+    if(len > seg_size)
+    {
+        seg_size = len;
+        seg_offs = realloc(seg_offs, seg_size * sizeof(seg_offs[0]));
+        if(seg_offs == NULL)
+        {
+            exit(1);
+        }
+    }
+    for(seg_len=0; seg_len<len; seg_len++)
+    {
+        if(    !replay_read_record(offset, &record)
+            || ((seg_len == 0) != (record.type == RECORDER_TYPE_KEYFRAME))
+          )
+        {
+            break;
+        }
+        seg_offs[seg_len] = offset;
+        offset += sizeof(record) + record.size;
+    }
+    if(seg_len == 0)
+    {
+        return 0;
+    }
+    seg   = s;
+    frame = keys[s].frame;
+    replay_apply(seg_offs[0]);
+    return 1;
+}
+
+
+
+// Seek to a frame (clipped to the recording)
+// -> Reads the nearest keyframe before and the deltas after it. Deltas are also applied
+//    backwards (XOR), so stepping back within the keyframe interval is as cheap as forward.
+void replay_seek(int64_t target)
+{
+    uint32_t lo = 0;
+    uint32_t hi = keys_cnt;
+
+    if(map == NULL)
+    {
+        return;
+    }
+    if(target < 0)       target = 0;
+    if(target >= frames) target = frames - 1;
+
+    // Segment of the target frame (last keyframe before it)
+    while(hi - lo > 1)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if(keys[mid].frame <= target)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    if((lo != seg) && !replay_load_segment(lo))
+    {
+        return;
+    }
+
+    uint32_t start = keys[seg].frame;
+    if(target >= start + seg_len) // Incomplete segment
+        target = start + seg_len - 1;
+
+    // Backwards from the keyframe, if it is nearer
+    if((target < frame) && (frame - target > target - start))
+    {
+        frame = start;
+        replay_apply(seg_offs[0]);
+    }
+    while(frame < target)
+    {
+        frame++;
+        replay_apply(seg_offs[frame - start]);
+    }
+    while(frame > target)
+    {
+        replay_apply(seg_offs[frame - start]);
+        frame--;
+        memcpy(&cur, &map[seg_offs[frame - start]], sizeof(cur));
+    }
+}
+
+
+
+// Set the cells of the current frame to the grid center
+void replay_set_to_grid(grid_t * grid)
+{
+    if((grid == 0) || (map == NULL))
+    {
+        return;
+    }
+    grid_unpack(grid, bits, cur.width, cur.height);
+}
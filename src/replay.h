@@ -0,0 +1,50 @@
+
+// File:    replay.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Replay of recorded runs (see recorder.h)
+
+#ifndef __REPLAY_H
+#define __REPLAY_H
+
+#include <stdint.h>
+#include "grid.h"
+
+
+
+// Open a recording (the file is mapped into memory, only the records which are needed are read)
+// -> Returns "1" if the file is a valid recording, otherwise see replay_get_error()
+uint8_t replay_open(const char * path);
+
+// Return "1" if a recording is opened
+uint8_t replay_is_open(void);
+
+// Get the reason why the recording could not be opened
+const char * replay_get_error(void);
+
+// Get the name of the opened recording (without path)
+const char * replay_get_name(void);
+
+// Get the number of frames in the recording
+uint32_t replay_get_frames(void);
+
+// Get the number of frames between two keyframes
+uint32_t replay_get_keyframe(void);
+
+// Get the current frame
+uint32_t replay_get_frame(void);
+
+// Get the generation of the current frame
+uint32_t replay_get_generation(void);
+
+// Seek to a frame (clipped to the recording)
+// -> Reads the nearest keyframe before and the deltas after it. Deltas are also applied
+//    backwards (XOR), so stepping back within the keyframe interval is as cheap as forward.
+void replay_seek(int64_t frame);
+
+// Set the cells of the current frame to the grid center
+void replay_set_to_grid(grid_t * grid);
+
+
+
+#endif // __REPLAY_H
@@ -0,0 +1,892 @@
+
+// File:    search.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Search for small soups with long lifespans ("ncgol search ...").
+//          A soup is a small random square in the center of a small universe, it is
+//          completely defined by its seed. The soups are simulated by worker processes
+//          (one per core), every worker has its own grid and end detection and takes
+//          every n-th seed. A soup ends at the end detection or after the maximum
+//          generations. By default a worker simulates 64 soups at once with the bit-sliced
+//          engine (see slice.c) and starts the next soup in every universe which has
+//          ended. The workers send their results over a pipe, the main process
+//          keeps the leaderboards (longest lifespan and largest population) and saves
+//          them regularly into a text file. With the same file the search resumes at
+//          the first seed which has not been tested by all workers.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "config.h"
+#include "search.h"
+#include "grid.h"
+#include "end_det.h"
+#include "patfile.h"
+#include "life.h"
+#include "slice.h"
+#include "timing.h"
+
+#define SEARCH_BOARD_DEFAULT "ncgol_search.txt"
+#define SEARCH_SIZE_DEFAULT  128   // Width and height of the universe
+#define SEARCH_SOUP_DEFAULT  16    // Width and height of the soup
+#define SEARCH_SOUP_MAX      256
+#define SEARCH_GENS_DEFAULT  50000 // Maximum generations of a soup
+#define SEARCH_TOP_DEFAULT   20    // Entries of a leaderboard
+#define SEARCH_TOP_MAX       1000
+#define SEARCH_JOBS_MAX      256
+#define SEARCH_SAVE_MS       10000 // Interval for saving the leaderboards
+
+// Result of a soup (sent from the worker to the main process)
+typedef struct
+{
+    uint64_t seed;
+    uint32_t lifespan;    // Generations until the end state (or the maximum generations)
+    uint32_t max_alive;   // Largest population
+    uint32_t final_alive; // Population of the end state
+    uint32_t period;      // Period of the end state (0: Unknown or not ended)
+} search_result_t;
+
+// Message of a worker to the main process
+typedef struct
+{
+    search_result_t result;
+    uint64_t        next;   // Lowest seed of the worker, which has not been finished
+} search_msg_t;
+
+typedef enum
+{
+    SEARCH_ENGINE_NONE,  // Not given
+    SEARCH_ENGINE_GRID,  // One soup after the other with the grid (end detection see end_det.c)
+    SEARCH_ENGINE_SLICE, // 64 soups at once (end detection see slice.c)
+    // ----------------
+    SEARCH_ENGINE_MAX
+} search_engine_t;
+
+static const char *engine_str[SEARCH_ENGINE_MAX] = {"", "grid", "slice"};
+
+// Leaderboard sorted by its key (descending)
+typedef struct
+{
+    const char      *name;
+    search_result_t entries[SEARCH_TOP_MAX];
+    uint32_t        cnt;
+} search_board_t;
+
+// Parameters of a search (the leaderboards are only comparable with the same parameters)
+typedef struct
+{
+    uint16_t width;
+    uint16_t height;
+    uint16_t soup;
+    uint32_t gens;
+    uint8_t  engine; // search_engine_t
+} search_param_t;
+
+static uint64_t soup_seed = 0;
+static uint16_t soup_size = SEARCH_SOUP_DEFAULT;
+
+static search_board_t board_life = {"lifespan",   {{0}}, 0};
+static search_board_t board_pop  = {"population", {{0}}, 0};
+static uint32_t       board_top  = SEARCH_TOP_DEFAULT;
+static uint64_t       board_next = 0; // First seed which has not been tested
+
+static volatile sig_atomic_t terminate = 0; // SIGINT or SIGTERM received
+
+
+
+// Function to get the next random number of a seed (SplitMix64)
+static uint64_t search_random(uint64_t * state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+
+
+// Set the soup for INITPATTERN_SOUP (random square of "size" cells, reproducible by its seed)
+void search_set_soup(uint64_t seed, uint16_t size)
+{
+    soup_seed = seed;
+    soup_size = size;
+}
+
+
+
+// Set the cells of the current soup to the grid center
+void search_set_to_center(grid_t * grid)
+{
+    uint16_t width  = (soup_size < grid_get_width()  ? soup_size : grid_get_width());
+    uint16_t height = (soup_size < grid_get_height() ? soup_size : grid_get_height());
+    uint16_t x_off  = (grid_get_width()  - width)  / 2;
+    uint16_t y_off  = (grid_get_height() - height) / 2;
+    uint64_t state  = soup_seed;
+    uint64_t bits   = 0;
+    uint8_t  cnt    = 0;
+
+    if(grid == 0)
+    {
+        return;
+    }
+    for(uint16_t y=0; y<height; y++)
+    {
+        for(uint16_t x=0; x<width; x++)
+        {
+            if(cnt == 0)
+            {
+                bits = search_random(&state);
+                cnt  = 64;
+            }
+            grid[x_off + x][y_off + y] = bits & 0x1;
+            bits >>= 1;
+            cnt--;
+        }
+    }
+}
+
+
+
+// Function to handle SIGINT and SIGTERM (the leaderboards are saved before the end)
+static void search_handle_signal(int sig)
+{
+    (void)sig;
+    terminate = 1;
+}
+
+
+
+// Function to get the key of a leaderboard entry
+static uint32_t search_get_key(const search_board_t * board, const search_result_t * result)
+{
+    return (board == &board_life ? result->lifespan : result->max_alive);
+}
+
+
+
+// Function to insert a result into a leaderboard (a seed is only kept once)
+static void search_board_insert(search_board_t * board, const search_result_t * result)
+{
+    uint32_t key = search_get_key(board, result);
+    uint32_t pos = board->cnt;
+
+    if((board->cnt == board_top) && (key <= search_get_key(board, &board->entries[board->cnt-1])))
+    {
+        return;
+    }
+    for(uint32_t i=0; i<board->cnt; i++)
+    {
+        if(board->entries[i].seed == result->seed)
+        {
+            return;
+        }
+    }
+    while((pos > 0) && (search_get_key(board, &board->entries[pos-1]) < key))
+        pos--;
+    if(board->cnt < board_top)
+        board->cnt++;
+    memmove(&board->entries[pos+1], &board->entries[pos], (board->cnt - 1 - pos) * sizeof(board->entries[0]));
+    board->entries[pos] = *result;
+}
+
+
+
+// Function to write a leaderboard into a file
+static void search_board_write(FILE * file, const search_board_t * board)
+{
+    for(uint32_t i=0; i<board->cnt; i++)
+    {
+        const search_result_t *r = &board->entries[i];
+        fprintf(file, "%-10s %20llu %10u %10u %10u %6u\n", board->name, (unsigned long long)r->seed,
+                r->lifespan, r->max_alive, r->final_alive, r->period);
+    }
+}
+
+
+
+// Function to save the leaderboards (written into a temporary file, which replaces the old one)
+// -> Returns "1" if the file has been written
+static uint8_t search_save(const char * path, const search_param_t * param)
+{
+    char path_tmp[1024];
+    FILE *file;
+
+    if(snprintf(path_tmp, sizeof(path_tmp), "%s.tmp", path) >= (int)sizeof(path_tmp))
+    {
+        return 0;
+    }
+    file = fopen(path_tmp, "w");
+    if(file == NULL)
+    {
+        return 0;
+    }
+    fprintf(file, "# ncgol soup search\n");
+    fprintf(file, "size %ux%u\n", param->width, param->height);
+    fprintf(file, "soup %u\n", param->soup);
+    fprintf(file, "gens %u\n", param->gens);
+    fprintf(file, "engine %s\n", engine_str[param->engine]);
+    fprintf(file, "next %llu\n", (unsigned long long)board_next);
+    fprintf(file, "#          seed                   lifespan  max_alive final_alive period\n");
+    search_board_write(file, &board_life);
+    search_board_write(file, &board_pop);
+    if(fclose(file) != 0)
+    {
+        unlink(path_tmp);
+        return 0;
+    }
+    return (rename(path_tmp, path) == 0);
+}
+
+
+
+// Function to check the parameters of a leaderboard file (same ranges as the options)
+// -> Returns "1" if the parameters are valid
+static uint8_t search_check_param(const search_param_t * param)
+{
+    return (    (param->width  >= 3) && (param->width  <= GRID_WIDTH_MAX)
+             && (param->height >= 3) && (param->height <= GRID_HEIGHT_MAX)
+             && (param->soup   >= 1) && (param->soup   <= SEARCH_SOUP_MAX)
+             && (param->gens   >= 1)
+           );
+}
+
+
+
+// Function to load the leaderboards of an earlier search
+// -> Returns "1" if the file has been read (the parameters are taken from the file)
+static uint8_t search_load(const char * path, search_param_t * param)
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+
+    if(file == NULL)
+    {
+        return 0;
+    }
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        search_result_t    r = {0};
+        unsigned           width, height, val;
+        unsigned long long seed;
+        char               name[16];
+        char               engine[16];
+
+        if(sscanf(line, "size %ux%u", &width, &height) == 2)
+        {
+            param->width  = (width  < UINT16_MAX ? width  : UINT16_MAX); // Too large values stay invalid (see search_check_param())
+            param->height = (height < UINT16_MAX ? height : UINT16_MAX);
+        }
+        else if(sscanf(line, "soup %u", &val) == 1)
+        {
+            param->soup = (val < UINT16_MAX ? val : UINT16_MAX);
+        }
+        else if(sscanf(line, "gens %u", &val) == 1)
+        {
+            param->gens = val;
+        }
+        else if(sscanf(line, "engine %15s", engine) == 1)
+        {
+            for(uint8_t i=SEARCH_ENGINE_GRID; i<SEARCH_ENGINE_MAX; i++)
+            {
+                if(strcmp(engine, engine_str[i]) == 0)
+                    param->engine = i;
+            }
+        }
+        else if(sscanf(line, "next %llu", &seed) == 1)
+        {
+            board_next = seed;
+        }
+        else if(sscanf(line, "%15s %llu %u %u %u %u", name, &seed, &r.lifespan, &r.max_alive, &r.final_alive, &r.period) == 6)
+        {
+            r.seed = seed;
+            if(strcmp(name, board_life.name) == 0)
+                search_board_insert(&board_life, &r);
+            else if(strcmp(name, board_pop.name) == 0)
+                search_board_insert(&board_pop, &r);
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+
+
+// Function to send a result to the main process
+// -> Returns "1" if the main process is still there
+static uint8_t search_send(int fd, const search_result_t * result, uint64_t next)
+{
+    search_msg_t msg;
+
+    msg.result = *result;
+    msg.next   = next;
+    return (write(fd, &msg, sizeof(msg)) == sizeof(msg)); // Smaller than PIPE_BUF -> Every write is atomic
+}
+
+
+
+// Function to simulate the soups of one worker process with the grid (every "step"-th seed from "seed" on, up to "end")
+static void search_worker_grid(int fd, const search_param_t * param, uint32_t window, uint64_t seed, uint32_t step, uint64_t end)
+{
+    static grid_t cells[GRID_WIDTH_MAX];
+    life_t        *life = life_create(param->width, param->height);
+
+    if(life == NULL)
+    {
+        return;
+    }
+    life_set_window(life, window);
+    grid_set_size(param->width, param->height); // Center of the soup
+
+    for(; seed<end; seed+=step)
+    {
+        search_result_t r = {0};
+
+        for(uint16_t x=0; x<param->width; x++)
+            memset(cells[x], 0, param->height);
+        search_set_soup(seed, param->soup);
+        search_set_to_center(cells);
+        life_set_grid(life, cells);
+        life_start(life);
+        r.seed      = seed;
+        r.max_alive = life_get_cells_alive(life);
+        while(!life_end_detected(life) && (life_get_generation(life) < param->gens))
+        {
+            life_step(life, 1);
+            if(life_get_cells_alive(life) > r.max_alive)
+                r.max_alive = life_get_cells_alive(life);
+        }
+        r.lifespan    = (life_end_detected(life) ? life_get_cycle_counter(life) : life_get_generation(life));
+        r.final_alive = life_get_cells_alive(life);
+        r.period      = (life_end_detected(life) ? life_get_period(life) : 0);
+
+        if(!search_send(fd, &r, (end - seed > step ? seed + step : end)))
+        {
+            break;
+        }
+        if((end - seed) <= step) // Avoid overflow at the end of the seeds
+        {
+            break;
+        }
+    }
+    life_destroy(life);
+}
+
+
+
+// Function to simulate the soups of one worker process with the bit-sliced engine (64 soups at once)
+// -> Every universe which has ended or reached the maximum generations gets the next seed
+// -> A soup whose end state has been found only by the snapshot of the engine is run again
+//    ("lead") and a second time with the delay of a multiple of its period ("trail"). The
+//    first generation in which both are the same is the exact begin of the end state.
+static void search_worker_slice(int fd, const search_param_t * param, uint64_t seed, uint32_t step, uint64_t end)
+{
+    typedef enum
+    {
+        LANE_IDLE,
+        LANE_SOUP,   // Soup until its end
+        LANE_LEAD,   // Soup again, for the exact lifespan
+        LANE_PARKED, // Waits for the delay of its lead
+        LANE_TRAIL,  // Soup delayed to its lead
+    } lane_mode_t;
+    static grid_t   cells[SLICE_SIZE_MAX];
+    lane_mode_t     mode[SLICE_UNIVERSES] = {LANE_IDLE};
+    uint64_t        seeds[SLICE_UNIVERSES];
+    uint8_t         pair[SLICE_UNIVERSES];   // Lead of a trail and trail of a lead (SLICE_UNIVERSES: none)
+    search_result_t result[SLICE_UNIVERSES]; // Result of a lead (without the exact lifespan)
+    uint8_t         leads = 0;
+    uint8_t         busy  = 1;
+
+    if(!slice_set_size(param->width, param->height))
+    {
+        return;
+    }
+    grid_set_size(param->width, param->height); // Center of the soup
+
+    while(busy)
+    {
+        uint64_t next = seed; // Lowest unfinished seed of this worker
+
+        // Fill the free universes (first the trails of the leads, then the next seeds)
+        for(uint8_t u=0; u<SLICE_UNIVERSES; u++)
+        {
+            if(mode[u] != LANE_IDLE)
+            {
+                continue;
+            }
+            for(uint8_t l=0; l<SLICE_UNIVERSES; l++)
+            {
+                if((mode[l] == LANE_LEAD) && (pair[l] == SLICE_UNIVERSES))
+                {
+                    mode[u] = LANE_PARKED;
+                    pair[u] = l;
+                    pair[l] = u;
+                    break;
+                }
+            }
+            if((mode[u] == LANE_IDLE) && (seed < end))
+            {
+                search_set_soup(seed, param->soup);
+                search_set_to_center(cells);
+                slice_set_universe(u, cells);
+                mode[u]  = LANE_SOUP;
+                seeds[u] = seed;
+                seed = (end - seed > step ? seed + step : end);
+            }
+        }
+
+        // Start the trails with a delay of a multiple of the period
+        busy = 0;
+        for(uint8_t u=0; u<SLICE_UNIVERSES; u++)
+        {
+            uint8_t l = pair[u];
+            if((mode[u] == LANE_PARKED) && (slice_get_generation(l) >= result[l].period) && ((slice_get_generation(l) % result[l].period) == 0))
+            {
+                search_set_soup(seeds[l], param->soup);
+                search_set_to_center(cells);
+                slice_set_universe(u, cells);
+                mode[u] = LANE_TRAIL;
+            }
+            if((mode[u] == LANE_SOUP) || (mode[u] == LANE_LEAD))
+            {
+                if(seeds[u] < next)
+                    next = seeds[u];
+            }
+            busy |= (mode[u] != LANE_IDLE);
+        }
+
+        slice_update();
+        uint64_t ended = slice_get_ended();
+        for(uint8_t u=0; u<SLICE_UNIVERSES; u++)
+        {
+            uint64_t bit = (uint64_t)1 << u;
+
+            if((mode[u] == LANE_SOUP) && ((ended & bit) || (slice_get_generation(u) >= param->gens)))
+            {
+                search_result_t r = {0};
+                r.seed        = seeds[u];
+                r.lifespan    = ((ended & bit) ? slice_get_lifespan(u) : slice_get_generation(u));
+                r.max_alive   = slice_get_max_alive(u);
+                r.final_alive = slice_get_alive(u);
+                r.period      = ((ended & bit) ? slice_get_period(u) : 0);
+                if((ended & bit) && !slice_is_exact(u) && (leads < SLICE_UNIVERSES / 4))
+                {
+                    // Run again for the exact lifespan
+                    search_set_soup(seeds[u], param->soup);
+                    search_set_to_center(cells);
+                    slice_set_universe(u, cells);
+                    mode[u]   = LANE_LEAD;
+                    pair[u]   = SLICE_UNIVERSES;
+                    result[u] = r;
+                    leads++;
+                    continue;
+                }
+                if(!search_send(fd, &r, next))
+                {
+                    return;
+                }
+                mode[u] = LANE_IDLE;
+            }
+            else if(mode[u] == LANE_TRAIL)
+            {
+                uint8_t l = pair[u];
+                if(slice_compare(u, l) || (slice_get_generation(u) >= param->gens))
+                {
+                    if(slice_get_generation(u) < result[l].lifespan)
+                        result[l].lifespan = slice_get_generation(u);
+                    if(!search_send(fd, &result[l], next))
+                    {
+                        return;
+                    }
+                    mode[u] = LANE_IDLE;
+                    mode[l] = LANE_IDLE;
+                    leads--;
+                }
+            }
+        }
+    }
+}
+
+
+
+// Function to simulate the soups of one worker process (every "step"-th seed from "seed" on, up to "end")
+// -> "window": Cycles which have to repeat for the end detection of the grid engine
+static void search_worker(int fd, const search_param_t * param, uint32_t window, uint64_t seed, uint32_t step, uint64_t end)
+{
+    signal(SIGINT,  SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    if(param->engine == SEARCH_ENGINE_SLICE)
+        search_worker_slice(fd, param, seed, step, end);
+    else
+        search_worker_grid(fd, param, window, seed, step, end);
+    _exit(0);
+}
+
+
+
+// Function to print the help of the search
+static void search_help(void)
+{
+    printf("Usage:\n");
+    printf("  ncgol search [options]\n");
+    printf("\n");
+    printf("Searches small random soups with long lifespans (SIGINT or SIGTERM: save and end)\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  -b, --board      Leaderboard file, resumes an earlier search (default %s)\n", SEARCH_BOARD_DEFAULT);
+    printf("  -e, --engine     Engine for the soups (default slice):\n");
+    printf("                   - grid  -> One soup after the other\n");
+    printf("                   - slice -> 64 soups at once, bit-sliced (maximum size %ux%u)\n", SLICE_SIZE_MAX, SLICE_SIZE_MAX);
+    printf("  -g, --gens       Maximum generations of a soup (default %u)\n", SEARCH_GENS_DEFAULT);
+    printf("  -h, --help       This Help\n");
+    printf("  -j, --jobs       Worker processes (default: number of cores)\n");
+    printf("  -n, --soups      Number of soups to test (0: until SIGINT or SIGTERM, default)\n");
+    printf("  -S, --soup       Size of the soup (default %u)\n", SEARCH_SOUP_DEFAULT);
+    printf("  -s, --size       Size of the universe WxH (default %ux%u)\n", SEARCH_SIZE_DEFAULT, SEARCH_SIZE_DEFAULT);
+    printf("  -t, --top        Entries of each leaderboard (default %u)\n", SEARCH_TOP_DEFAULT);
+    printf("  -w, --window     Cycles which have to repeat for the end detection (50-%i, default %i)\n", END_DET_WINDOW_MAX, END_DET_WINDOW_DEFAULT);
+    printf("  -x, --export     Write the soup of a seed as RLE file to stdout\n");
+}
+
+
+
+// Run the soup search with the arguments after "search"
+// -> Returns the exit code of the program
+int search_main(int argc, char * argv[])
+{
+    const char     *board_path = SEARCH_BOARD_DEFAULT;
+    search_param_t param  = {0}; // 0: Not given
+    search_param_t loaded = {0};
+    uint32_t       jobs   = grid_get_cpu_cores();
+    uint32_t       window = END_DET_WINDOW_DEFAULT;
+    uint64_t       soups  = 0;
+    uint8_t        export = 0;
+    uint64_t       export_seed = 0;
+
+    while(1)
+    {
+        static struct option long_options[] =
+        {
+            {"board",  required_argument, 0, 'b'},
+            {"engine", required_argument, 0, 'e'},
+            {"gens",   required_argument, 0, 'g'},
+            {"help",   no_argument,       0, 'h'},
+            {"jobs",   required_argument, 0, 'j'},
+            {"soups",  required_argument, 0, 'n'},
+            {"soup",   required_argument, 0, 'S'},
+            {"size",   required_argument, 0, 's'},
+            {"top",    required_argument, 0, 't'},
+            {"window", required_argument, 0, 'w'},
+            {"export", required_argument, 0, 'x'},
+            {0, 0, 0, 0}
+        };
+
+        int c = getopt_long(argc, argv, "b:e:g:hj:n:S:s:t:w:x:", long_options, 0);
+        if(c == -1)
+        {
+            break;
+        }
+
+        switch(c)
+        {
+            case 'b':
+            {
+                board_path = optarg;
+                break;
+            }
+
+            case 'e':
+            {
+                for(uint8_t i=SEARCH_ENGINE_GRID; i<SEARCH_ENGINE_MAX; i++)
+                {
+                    if(strcmp(optarg, engine_str[i]) == 0)
+                        param.engine = i;
+                }
+                if(param.engine == SEARCH_ENGINE_NONE)
+                {
+                    fprintf(stderr, "Invalid engine value: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+
+            case 'g':
+            {
+                param.gens = strtoul(optarg, NULL, 10);
+                if(param.gens == 0)
+                {
+                    fprintf(stderr, "Invalid gens value: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+
+            case 'h':
+            {
+                search_help();
+                return 0;
+            }
+
+            case 'j':
+            {
+                jobs = strtoul(optarg, NULL, 10);
+                if((jobs < 1) || (jobs > SEARCH_JOBS_MAX))
+                {
+                    fprintf(stderr, "Invalid jobs value: %s (1-%u)\n", optarg, SEARCH_JOBS_MAX);
+                    return 1;
+                }
+                break;
+            }
+
+            case 'n':
+            {
+                soups = strtoull(optarg, NULL, 10);
+                break;
+            }
+
+            case 'S':
+            {
+                param.soup = strtoul(optarg, NULL, 10);
+                if((param.soup < 1) || (param.soup > SEARCH_SOUP_MAX))
+                {
+                    fprintf(stderr, "Invalid soup value: %s (1-%u)\n", optarg, SEARCH_SOUP_MAX);
+                    return 1;
+                }
+                break;
+            }
+
+            case 's':
+            {
+                unsigned width, height;
+                if(    (sscanf(optarg, "%ux%u", &width, &height) != 2)
+                    || (width  < 3) || (width  > GRID_WIDTH_MAX)
+                    || (height < 3) || (height > GRID_HEIGHT_MAX)
+                  )
+                {
+                    fprintf(stderr, "Invalid size value: %s\n", optarg);
+                    return 1;
+                }
+                param.width  = width;
+                param.height = height;
+                break;
+            }
+
+            case 't':
+            {
+                board_top = strtoul(optarg, NULL, 10);
+                if((board_top < 1) || (board_top > SEARCH_TOP_MAX))
+                {
+                    fprintf(stderr, "Invalid top value: %s (1-%u)\n", optarg, SEARCH_TOP_MAX);
+                    return 1;
+                }
+                break;
+            }
+
+            case 'w':
+            {
+                int val = atoi(optarg);
+                if((val < 50) || (val > END_DET_WINDOW_MAX))
+                {
+                    fprintf(stderr, "Invalid window value: %s\n", optarg);
+                    return 1;
+                }
+                window = val;
+                break;
+            }
+
+            case 'x':
+            {
+                export      = 1;
+                export_seed = strtoull(optarg, NULL, 10);
+                break;
+            }
+
+            case '?': // getopt_long() already printed an error message
+            default:
+            {
+                return 1;
+            }
+        }
+    }
+    if(optind < argc)
+    {
+        fprintf(stderr, "ncgol search: unrecognized argument \'%s\'\n", argv[optind]);
+        return 1;
+    }
+
+    // Parameters of an earlier search (given parameters have to be the same)
+    if(!export && search_load(board_path, &loaded))
+    {
+        if(loaded.engine == SEARCH_ENGINE_NONE) // Leaderboard from before the bit-sliced engine
+            loaded.engine = SEARCH_ENGINE_GRID;
+        if(    ((param.width  != 0) && ((param.width != loaded.width) || (param.height != loaded.height)))
+            || ((param.soup   != 0) && (param.soup   != loaded.soup))
+            || ((param.gens   != 0) && (param.gens   != loaded.gens))
+            || ((param.engine != 0) && (param.engine != loaded.engine))
+          )
+        {
+            fprintf(stderr, "Leaderboard %s has been created with other parameters (size %ux%u, soup %u, gens %u, engine %s)\n",
+                    board_path, loaded.width, loaded.height, loaded.soup, loaded.gens, engine_str[loaded.engine]);
+            return 1;
+        }
+        if(!search_check_param(&loaded))
+        {
+            fprintf(stderr, "Leaderboard %s has invalid parameters (size %ux%u, soup %u, gens %u)\n",
+                    board_path, loaded.width, loaded.height, loaded.soup, loaded.gens);
+            return 1;
+        }
+        param = loaded;
+    }
+    if(param.width == 0)
+    {
+        param.width  = SEARCH_SIZE_DEFAULT;
+        param.height = SEARCH_SIZE_DEFAULT;
+    }
+    if(param.soup == 0) param.soup = SEARCH_SOUP_DEFAULT;
+    if(param.gens == 0) param.gens = SEARCH_GENS_DEFAULT;
+    if(param.engine == SEARCH_ENGINE_NONE) param.engine = SEARCH_ENGINE_SLICE;
+    if((param.engine == SEARCH_ENGINE_SLICE) && ((param.width > SLICE_SIZE_MAX) || (param.height > SLICE_SIZE_MAX)))
+    {
+        fprintf(stderr, "Size %ux%u is too large for the slice engine (maximum %ux%u)\n", param.width, param.height, SLICE_SIZE_MAX, SLICE_SIZE_MAX);
+        return 1;
+    }
+
+    // Export only the soup of a seed
+    if(export)
+    {
+        static grid_t soup[SEARCH_SOUP_MAX];
+        grid_set_size(param.soup, param.soup);
+        search_set_soup(export_seed, param.soup);
+        search_set_to_center(soup);
+        return (patfile_save_rle("-", soup, param.soup, param.soup, 0) ? 0 : 1);
+    }
+
+    // Start the workers (every worker takes every "jobs"-th seed)
+    int      fds[SEARCH_JOBS_MAX];
+    pid_t    pids[SEARCH_JOBS_MAX];
+    uint64_t next[SEARCH_JOBS_MAX]; // Next seed of every worker
+    uint64_t start   = board_next;
+    uint64_t end     = (soups > 0 ? start + soups : UINT64_MAX);
+    uint32_t running = 0;
+    uint64_t tested  = 0;
+
+    signal(SIGINT,  search_handle_signal);
+    signal(SIGTERM, search_handle_signal);
+    signal(SIGPIPE, SIG_IGN);
+    for(uint32_t j=0; j<jobs; j++)
+    {
+        int fd[2];
+        if(pipe(fd) != 0)
+        {
+            exit(1);
+        }
+        pids[j] = fork();
+        if(pids[j] < 0)
+        {
+            exit(1);
+        }
+        if(pids[j] == 0)
+        {
+            close(fd[0]);
+            search_worker(fd[1], &param, window, start + j, jobs, end);
+        }
+        close(fd[1]);
+        fds[j]  = fd[0];
+        next[j] = start + j;
+        running++;
+    }
+
+    // Collect the results
+    uint64_t start_ms  = timing_now_ms();
+    uint64_t save_ms   = start_ms + SEARCH_SAVE_MS;
+    uint64_t report_ms = start_ms + 1000;
+    while((running > 0) && !terminate)
+    {
+        struct pollfd events[SEARCH_JOBS_MAX];
+        for(uint32_t j=0; j<jobs; j++)
+        {
+            events[j].fd      = fds[j];
+            events[j].events  = POLLIN;
+            events[j].revents = 0;
+        }
+        poll(events, jobs, 1000);
+
+        for(uint32_t j=0; j<jobs; j++)
+        {
+            search_msg_t msgs[64];
+            ssize_t      len;
+
+            if(!(events[j].revents & (POLLIN | POLLHUP)))
+            {
+                continue;
+            }
+            len = read(fds[j], msgs, sizeof(msgs));
+            if(len <= 0)
+            {
+                close(fds[j]);
+                fds[j] = -1; // Ignored by poll()
+                next[j] = end;
+                running--;
+                continue;
+            }
+            for(uint32_t i=0; i<len/sizeof(msgs[0]); i++)
+            {
+                search_board_insert(&board_life, &msgs[i].result);
+                search_board_insert(&board_pop,  &msgs[i].result);
+                next[j] = msgs[i].next;
+                tested++;
+            }
+        }
+
+        // First seed which has been tested by all workers
+        board_next = end;
+        for(uint32_t j=0; j<jobs; j++)
+        {
+            if(next[j] < board_next)
+                board_next = next[j];
+        }
+
+        // Report and save regularly
+        uint64_t now_ms = timing_now_ms();
+        if(now_ms >= report_ms)
+        {
+            fprintf(stderr, "\rSoups: %llu (%.0f/s)  Longest: %u (seed %llu)  Largest: %u (seed %llu)   ",
+                    (unsigned long long)tested, (double)tested * 1000 / (now_ms - start_ms),
+                    board_life.entries[0].lifespan,  (unsigned long long)board_life.entries[0].seed,
+                    board_pop.entries[0].max_alive, (unsigned long long)board_pop.entries[0].seed);
+            report_ms = now_ms + 1000;
+        }
+        if(now_ms >= save_ms)
+        {
+            search_save(board_path, &param);
+            save_ms = now_ms + SEARCH_SAVE_MS;
+        }
+    }
+    fprintf(stderr, "\n");
+
+    // Stop the workers and save the leaderboards
+    for(uint32_t j=0; j<jobs; j++)
+    {
+        if(fds[j] >= 0)
+        {
+            kill(pids[j], SIGTERM);
+            close(fds[j]);
+        }
+        waitpid(pids[j], NULL, 0);
+    }
+    if(!search_save(board_path, &param))
+    {
+        fprintf(stderr, "Leaderboard %s can not be written\n", board_path);
+        return 1;
+    }
+    printf("#          seed                   lifespan  max_alive final_alive period\n");
+    search_board_write(stdout, &board_life);
+    search_board_write(stdout, &board_pop);
+    return 0;
+}
@@ -0,0 +1,27 @@
+
+// File:    search.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Search for small soups with long lifespans ("ncgol search ...")
+
+#ifndef __SEARCH_H
+#define __SEARCH_H
+
+#include <stdint.h>
+#include "grid.h"
+
+
+
+// Run the soup search with the arguments after "search"
+// -> Returns the exit code of the program
+int search_main(int argc, char * argv[]);
+
+// Set the soup for INITPATTERN_SOUP (random square of "size" cells, reproducible by its seed)
+void search_set_soup(uint64_t seed, uint16_t size);
+
+// Set the cells of the current soup to the grid center
+void search_set_to_center(grid_t * grid);
+
+
+
+#endif // __SEARCH_H
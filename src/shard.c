@@ -0,0 +1,336 @@
+
+// File:    shard.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Simulation of one grid by several worker processes ("ncgol run --shards ...").
+//          The columns of the grid are split into one part (shard) per worker. Every worker
+//          keeps its columns in its own memory and gets only the columns at its borders (halo)
+//          from its neighbors through shared memory:
+//          - The two edge columns of a generation are calculated first and published in
+//            the shared memory (one buffer per even and odd generation)
+//          - The inner columns are calculated afterwards, so the neighbors can already go on
+//            with their next generation while this worker is still busy
+//          - Before the next generation the worker only waits for the edges of its two
+//            neighbors, there is no barrier over all workers
+//          The coordinator (calling process) adds the living cells and the hashes of all
+//          workers for every generation and takes them as next generation of a simulation of
+//          life.c (cycle counter and end detection like the grid). The workers can be at
+//          most two generations ahead of the coordinator, so at the end detection every
+//          worker still has the detected generation (current or previous cells).
+//          The hash is the same as the hash of the grid, so the results are the same as
+//          with one process.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "shard.h"
+#include "life.h"
+
+#define SHARD_SLOTS    4 // Statistics of the newest generations of a worker (ring buffer)
+#define SHARD_LEAD     2 // Generations which the workers can be ahead of the coordinator
+#define SHARD_SPINS 4096 // Waiting loops between two checks for ended processes
+
+// State of one worker in the shared memory
+typedef struct
+{
+    _Alignas(64)
+    _Atomic uint32_t edge_gen; // Newest generation of the published edge columns
+    _Atomic uint32_t done_gen; // Newest finished generation
+    uint32_t         alive[SHARD_SLOTS];
+    uint64_t         hash[SHARD_SLOTS];  // XOR of the changes of the hash since generation 0
+    uint16_t         x_beg;
+    uint16_t         x_cnt;
+} shard_worker_t;
+
+// Shared memory of all processes (followed by the edge columns of the workers)
+typedef struct
+{
+    _Atomic uint32_t ack_gen;  // Newest generation handled by the coordinator
+    _Atomic uint32_t stop_gen; // Last generation (UINT32_MAX: Not known yet)
+    uint16_t         shards;
+    uint16_t         width;
+    uint16_t         height;
+    pid_t            coordinator;
+    shard_worker_t   worker[SHARD_MAX];
+} shard_shm_t;
+
+enum
+{
+    EDGE_LEFT,
+    EDGE_RIGHT,
+};
+
+static shard_shm_t *shm   = NULL;
+static grid_t      *cells = NULL; // Shared grid for the first and the last generation
+
+
+
+// Function to get the buffer of an edge column of a worker ("gen": generation of the column)
+static uint8_t * shard_edge(uint16_t shard, uint32_t gen, uint8_t side)
+{
+    uint8_t *edges = (uint8_t *)(shm + 1);
+    return &edges[(((uint32_t)shard * 2 + (gen % 2)) * 2 + side) * shm->height];
+}
+
+
+
+// Function to wait a moment in a waiting loop of a worker
+// -> The worker ends if the coordinator does not exist any more
+static void shard_worker_wait(uint32_t * spins)
+{
+    if((++(*spins) % SHARD_SPINS) == 0)
+    {
+        if(getppid() != shm->coordinator)
+        {
+            _exit(1);
+        }
+    }
+    sched_yield();
+}
+
+
+
+// Function to calculate the columns of one worker (forked process)
+static void shard_worker(uint16_t shard)
+{
+    shard_worker_t *w      = &shm->worker[shard];
+    uint16_t       left    = (shard + shm->shards - 1) % shm->shards;
+    uint16_t       right   = (shard + 1) % shm->shards;
+    uint16_t       height  = shm->height;
+    uint16_t       cols    = w->x_cnt;
+    uint32_t       size    = ((uint32_t)cols + 2) * height; // With the halo columns on both sides
+    uint8_t        *cur    = malloc(size);
+    uint8_t        *next   = malloc(size);
+    uint64_t       hash    = 0;
+    uint32_t       spins   = 0;
+    uint32_t       gen;
+
+    if((cur == NULL) || (next == NULL))
+    {
+        _exit(1);
+    }
+
+    // Own columns with the halo (x = 0 and x = cols + 1)
+    for(uint32_t x=0; x<(uint32_t)cols+2; x++)
+    {
+        memcpy(&cur[x * height], cells[(w->x_beg + shm->width + x - 1) % shm->width], height);
+    }
+
+    for(gen=0; ; gen++)
+    {
+        uint64_t hash_diff;
+        uint32_t alive;
+        uint8_t  *tmp;
+
+        // Wait until the coordinator allows the next generation
+        while(1)
+        {
+            if(gen >= atomic_load(&shm->stop_gen))
+            {
+                break;
+            }
+            if(gen <= atomic_load(&shm->ack_gen) + SHARD_LEAD - 1)
+            {
+                break;
+            }
+            shard_worker_wait(&spins);
+        }
+        if(gen >= atomic_load(&shm->stop_gen))
+        {
+            break;
+        }
+
+        // Halo from the edges of the neighbors
+        if(gen > 0)
+        {
+            while((atomic_load(&shm->worker[left].edge_gen) < gen) || (atomic_load(&shm->worker[right].edge_gen) < gen))
+            {
+                shard_worker_wait(&spins);
+            }
+            memcpy(&cur[0],                           shard_edge(left,  gen, EDGE_RIGHT), height);
+            memcpy(&cur[((uint32_t)cols + 1) * height], shard_edge(right, gen, EDGE_LEFT),  height);
+        }
+
+        // Edges first, then the inner columns
+        alive  = life_calc_columns(cur, next, height, cols + 2, height, 1, 1, w->x_beg - 1, &hash_diff);
+        hash  ^= hash_diff;
+        alive += life_calc_columns(cur, next, height, cols + 2, height, cols, 1, w->x_beg - 1, &hash_diff);
+        hash  ^= hash_diff;
+        memcpy(shard_edge(shard, gen + 1, EDGE_LEFT),  &next[height],                  height);
+        memcpy(shard_edge(shard, gen + 1, EDGE_RIGHT), &next[(uint32_t)cols * height], height);
+        atomic_store(&w->edge_gen, gen + 1);
+
+        alive += life_calc_columns(cur, next, height, cols + 2, height, 2, cols - 2, w->x_beg - 1, &hash_diff);
+        hash  ^= hash_diff;
+        w->alive[(gen + 1) % SHARD_SLOTS] = alive;
+        w->hash[(gen + 1) % SHARD_SLOTS]  = hash;
+        atomic_store(&w->done_gen, gen + 1);
+
+        tmp  = cur;
+        cur  = next;
+        next = tmp;
+    }
+
+    // Last generation back to the shared grid (the worker can be one generation further)
+    if(gen > atomic_load(&shm->stop_gen))
+    {
+        cur = next;
+    }
+    for(uint32_t x=0; x<cols; x++)
+    {
+        memcpy(cells[w->x_beg + x], &cur[(x + 1) * height], height);
+    }
+    _exit(0);
+}
+
+
+
+// Function to simulate a grid with worker processes, every worker calculates a part of the columns
+// -> Starts with the cells of "grid" and ends with the last generation in "grid"
+// -> Stops after "gens" generations (0: when the end is detected, "window": see grid_set_window())
+// -> "stats_fn" is called for every "interval" generations (0: none) before the last one
+// -> "stats": Statistics of the last generation
+// -> Returns "1" if the simulation has been successful
+uint8_t shard_run(grid_t * grid, uint16_t width, uint16_t height, uint16_t shards, uint32_t gens, uint32_t window,
+                  uint32_t interval, shard_stats_fn_t stats_fn, shard_stats_t * stats)
+{
+    size_t    shm_size   = sizeof(shard_shm_t) + (size_t)shards * 4 * height;
+    size_t    cells_size = (size_t)width * sizeof(grid_t);
+    pid_t     pids[SHARD_MAX];
+    uint16_t  started = 0;
+    uint8_t   ok      = 1;
+    uint64_t  hash0;
+    life_t    *life;
+
+    if((shards == 0) || (shards > SHARD_MAX) || (width / shards < SHARD_WIDTH_MIN))
+    {
+        return 0;
+    }
+    shm   = mmap(NULL, shm_size,   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    cells = mmap(NULL, cells_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    life  = (cells != MAP_FAILED ? life_create_on(width, height, GRID_HEIGHT_MAX, (uint8_t *)cells, NULL) : NULL);
+    if((life == NULL) || (shm == MAP_FAILED) || (cells == MAP_FAILED))
+    {
+        if(shm != MAP_FAILED)   munmap(shm, shm_size);
+        if(cells != MAP_FAILED) munmap(cells, cells_size);
+        life_destroy(life);
+        return 0;
+    }
+
+    // First generation (the generations are calculated by the workers)
+    memset(stats, 0, sizeof(*stats));
+    for(uint16_t x=0; x<width; x++)
+        memcpy(cells[x], grid[x], height);
+    life_set_window(life, window);
+    life_start(life);
+    hash0              = life_get_hash(life);
+    stats->cells_alive = life_get_cells_alive(life);
+    stats->hash        = hash0;
+
+    atomic_init(&shm->ack_gen, 0);
+    atomic_init(&shm->stop_gen, (gens > 0 ? gens : UINT32_MAX));
+    shm->shards      = shards;
+    shm->width       = width;
+    shm->height      = height;
+    shm->coordinator = getpid();
+    for(uint16_t i=0; i<shards; i++)
+    {
+        shm->worker[i].x_beg = ((uint32_t)width * i) / shards;
+        shm->worker[i].x_cnt = ((uint32_t)width * (i+1)) / shards - shm->worker[i].x_beg;
+        atomic_init(&shm->worker[i].edge_gen, 0);
+        atomic_init(&shm->worker[i].done_gen, 0);
+    }
+
+    // Start the workers
+    for(started=0; started<shards; started++)
+    {
+        pids[started] = fork();
+        if(pids[started] == 0)
+        {
+            shard_worker(started);
+        }
+        else if(pids[started] < 0)
+        {
+            ok = 0;
+            break;
+        }
+    }
+
+    // Add the statistics of all workers for every generation
+    for(uint32_t gen=1; ok && (gens > 0 ? (stats->generation < gens) : !stats->end_detected); gen++)
+    {
+        uint32_t spins = 0;
+        uint32_t alive = 0;
+        uint64_t hash  = hash0;
+
+        for(uint16_t i=0; ok && (i<shards); i++)
+        {
+            while(atomic_load(&shm->worker[i].done_gen) < gen)
+            {
+                // A worker which ends before this generation can not be waited for
+                if(((++spins % SHARD_SPINS) == 0) && (waitpid(pids[i], NULL, WNOHANG) == pids[i]))
+                {
+                    ok = 0;
+                    break;
+                }
+                sched_yield();
+            }
+            alive += shm->worker[i].alive[gen % SHARD_SLOTS];
+            hash  ^= shm->worker[i].hash[gen % SHARD_SLOTS];
+        }
+        if(!ok)
+        {
+            break;
+        }
+
+        life_next(life, alive, hash);
+        stats->generation    = life_get_generation(life);
+        stats->cells_alive   = life_get_cells_alive(life);
+        stats->hash          = life_get_hash(life);
+        stats->end_detected  = life_end_detected(life);
+        stats->period        = life_get_period(life);
+        stats->cycle_counter = life_get_cycle_counter(life);
+
+        if((gens > 0 ? (gen >= gens) : stats->end_detected))
+        {
+            atomic_store(&shm->stop_gen, gen);
+            break;
+        }
+        if((stats_fn != NULL) && (interval > 0) && ((gen % interval) == 0))
+        {
+            stats_fn(stats);
+        }
+        atomic_store(&shm->ack_gen, gen);
+    }
+
+    // Wait for the workers, which write the last generation
+    for(uint16_t i=0; i<started; i++)
+    {
+        int status;
+
+        if(!ok)
+        {
+            kill(pids[i], SIGTERM);
+        }
+        if((waitpid(pids[i], &status, 0) == pids[i]) && (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)))
+        {
+            ok = 0;
+        }
+    }
+    if(ok)
+    {
+        for(uint16_t x=0; x<width; x++)
+            memcpy(grid[x], cells[x], height);
+    }
+
+    munmap(shm, shm_size);
+    munmap(cells, cells_size);
+    life_destroy(life);
+    return ok;
+}
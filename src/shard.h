@@ -0,0 +1,43 @@
+
+// File:    shard.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Simulation of one grid by several worker processes (see shard.c)
+
+#ifndef __SHARD_H
+#define __SHARD_H
+
+#include <stdint.h>
+#include "grid.h"
+
+#define SHARD_MAX        64 // Maximum number of worker processes
+#define SHARD_WIDTH_MIN   3 // Minimum number of columns of one worker
+
+// Statistics of a generation of the whole grid
+typedef struct
+{
+    uint32_t generation;
+    uint32_t cycle_counter; // See grid_get_cycle_counter()
+    uint32_t cells_alive;
+    uint64_t hash;
+    uint8_t  end_detected;
+    uint32_t period;        // Exact period of the end state (0: Unknown)
+} shard_stats_t;
+
+// Function which gets the statistics of a generation (see shard_run())
+typedef void (*shard_stats_fn_t)(const shard_stats_t * stats);
+
+
+
+// Function to simulate a grid with worker processes, every worker calculates a part of the columns
+// -> Starts with the cells of "grid" and ends with the last generation in "grid"
+// -> Stops after "gens" generations (0: when the end is detected, "window": see grid_set_window())
+// -> "stats_fn" is called for every "interval" generations (0: none) before the last one
+// -> "stats": Statistics of the last generation
+// -> Returns "1" if the simulation has been successful
+uint8_t shard_run(grid_t * grid, uint16_t width, uint16_t height, uint16_t shards, uint32_t gens, uint32_t window,
+                  uint32_t interval, shard_stats_fn_t stats_fn, shard_stats_t * stats);
+
+
+
+#endif // __SHARD_H
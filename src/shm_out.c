@@ -0,0 +1,116 @@
+
+// File:    shm_out.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Export of the live grid into POSIX shared memory ("--shm").
+//          The three frames of the grid (see grid.c) are placed directly into the shared
+//          memory, so the simulation calculates into it and nothing is copied. Other local
+//          processes map the shared memory read-only and take the newest frame.
+//          Every frame has a sequence counter (seqlock), which is odd while the simulation
+//          writes into the frame. A reader checks the counter before and after reading the
+//          frame and reads again if it has changed. The simulation only stores the counters
+//          and the newest frame (no locks and no syscalls), it never waits for a reader.
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "shm_out.h"
+#include "grid.h"
+
+#define SHM_OUT_PAGE 4096 // The frames start at a page boundary
+
+static shm_out_header_t *header = NULL;
+static const char       *shm_name = NULL;
+
+
+
+// Create the shared memory "name" (e.g. "/ncgol") and place the frames of the grid into it
+// -> Has to be called before grid_init()
+// -> Returns "1" if successful
+uint8_t shm_out_open(const char * name)
+{
+    size_t offset = ((sizeof(shm_out_header_t) + SHM_OUT_PAGE - 1) / SHM_OUT_PAGE) * SHM_OUT_PAGE;
+    size_t size   = offset + SHM_OUT_FRAMES * sizeof(grid_frame_t);
+    void   *map;
+    int    fd;
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        return 0;
+    }
+    if(ftruncate(fd, size) != 0)
+    {
+        close(fd);
+        shm_unlink(name);
+        return 0;
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return 0;
+    }
+
+    header = map;
+    memcpy(header->magic, SHM_OUT_MAGIC, sizeof(header->magic));
+    header->version      = SHM_OUT_VERSION;
+    header->frames       = SHM_OUT_FRAMES;
+    header->frame_offset = offset;
+    header->frame_size   = sizeof(grid_frame_t);
+    header->width_max    = GRID_WIDTH_MAX;
+    header->height_max   = GRID_HEIGHT_MAX;
+    shm_name = name;
+
+    grid_set_frames((grid_frame_t *)((uint8_t *)map + offset));
+    return 1;
+}
+
+
+
+// Return "1" if the frames of the grid are placed into the shared memory
+uint8_t shm_out_is_open(void)
+{
+    return (header != NULL);
+}
+
+
+
+// Function to mark a frame as finished generation and another one as being written (called by the grid)
+void shm_out_publish(uint8_t frame_done, uint32_t generation, uint8_t frame_write)
+{
+    if(header == NULL)
+    {
+        return;
+    }
+
+    // Finished frame (its counter is odd since it has been taken for writing)
+    header->generation[frame_done] = generation;
+    if(atomic_load_explicit(&header->seq[frame_done], memory_order_relaxed) & 1)
+    {
+        atomic_fetch_add_explicit(&header->seq[frame_done], 1, memory_order_release);
+    }
+    atomic_store_explicit(&header->latest, frame_done, memory_order_release);
+
+    // Frame which is written from now on
+    if(!(atomic_load_explicit(&header->seq[frame_write], memory_order_relaxed) & 1))
+    {
+        atomic_fetch_add_explicit(&header->seq[frame_write], 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+    }
+}
+
+
+
+// Remove the name of the shared memory (processes which have mapped it can still read it)
+void shm_out_close(void)
+{
+    if(shm_name != NULL)
+    {
+        shm_unlink(shm_name);
+        shm_name = NULL;
+    }
+}
@@ -0,0 +1,57 @@
+
+// File:    shm_out.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Export of the live grid into POSIX shared memory (see shm_out.c)
+
+#ifndef __SHM_OUT_H
+#define __SHM_OUT_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "grid.h"
+
+#define SHM_OUT_MAGIC   "NCGOLSHM"
+#define SHM_OUT_VERSION 1
+#define SHM_OUT_FRAMES  3 // The frames of the grid (see grid_get_frame())
+
+// Header at the beginning of the shared memory
+// -> The frames (grid_frame_t) follow at "frame_offset", every "frame_size" bytes
+// -> Reading a frame (seqlock):
+//    1. i = latest, s1 = seq[i] (acquire). Odd: The frame is written -> Start again
+//    2. Read generation[i] and the frame
+//    3. s2 = seq[i] (after an acquire fence). s1 != s2: The frame has changed -> Start again
+typedef struct
+{
+    char             magic[8];         // SHM_OUT_MAGIC (without termination)
+    uint32_t         version;          // SHM_OUT_VERSION
+    uint32_t         frames;           // SHM_OUT_FRAMES
+    uint32_t         frame_offset;     // Offset of the first frame from the beginning of the shared memory
+    uint32_t         frame_size;       // sizeof(grid_frame_t)
+    uint32_t         width_max;        // GRID_WIDTH_MAX  (cells[x][y] of a frame)
+    uint32_t         height_max;       // GRID_HEIGHT_MAX
+    _Atomic uint32_t latest;           // Frame with the newest generation
+    uint32_t         reserved;
+    _Atomic uint64_t seq[SHM_OUT_FRAMES];        // Sequence counter of every frame (odd: being written)
+    uint64_t         generation[SHM_OUT_FRAMES]; // Generation since the initialization of every frame
+} shm_out_header_t;
+
+
+
+// Create the shared memory "name" (e.g. "/ncgol") and place the frames of the grid into it
+// -> Has to be called before grid_init()
+// -> Returns "1" if successful
+uint8_t shm_out_open(const char * name);
+
+// Return "1" if the frames of the grid are placed into the shared memory
+uint8_t shm_out_is_open(void);
+
+// Function to mark a frame as finished generation and another one as being written (called by the grid)
+void shm_out_publish(uint8_t frame_done, uint32_t generation, uint8_t frame_write);
+
+// Remove the name of the shared memory (processes which have mapped it can still read it)
+void shm_out_close(void);
+
+
+
+#endif // __SHM_OUT_H
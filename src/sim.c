@@ -0,0 +1,425 @@
+
+// File:    sim.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Simulation thread for the Game of Life.
+//          The simulation runs in its own thread and steps the grid with the selected speed.
+//          The UI thread sends commands over a lock-free queue (one producer, one consumer)
+//          and draws the finished generations from grid_get_frame() at display rate.
+//          So a slow generation on a huge grid does not delay keys or drawing.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "config.h"
+#include "sim.h"
+#include "grid.h"
+#include "timing.h"
+#include "snapshot.h"
+#include "replay.h"
+#include "stream.h"
+
+typedef enum
+{
+    SIM_CMD_SPEED, // Set speed level            (arg: speed)
+    SIM_CMD_SIZE,  // Set grid size              (arg: width << 16 | height)
+    SIM_CMD_INIT,  // Initialize grid            (arg: initpattern_t)
+    SIM_CMD_RUN,   // Start/stop the generations (arg: 0 or 1)
+    SIM_CMD_SAVE,  // Save a snapshot and wait for the file (arg: -)
+    SIM_CMD_REVERSE, // Play a recording backwards (arg: 0 or 1)
+    SIM_CMD_SEEK,  // Seek in a recording        (arg: frames, signed)
+    SIM_CMD_REWIND, // Go back some generations  (arg: generations)
+    SIM_CMD_GOTO,  // Fast forward to a generation (arg: generation, SIM_GOTO_END or SIM_GOTO_NONE)
+    // ----------------
+    SIM_CMD_MAX
+} sim_cmd_t;
+
+typedef struct
+{
+    sim_cmd_t cmd;
+    uint32_t  arg;
+} sim_cmd_entry_t;
+
+// Command queue (written by the UI thread, read by the simulation thread)
+#define SIM_QUEUE_LEN 64 // Has to be a power of two
+static sim_cmd_entry_t  queue[SIM_QUEUE_LEN];
+static _Atomic uint32_t queue_head = 0; // Next entry to write (UI thread)
+static _Atomic uint32_t queue_tail = 0; // Next entry to read (simulation thread)
+static _Atomic uint32_t init_ack   = 0; // Number of processed SIM_CMD_INIT
+static _Atomic uint32_t save_ack   = 0; // Number of processed SIM_CMD_SAVE
+static _Atomic uint32_t goto_state_target = SIM_GOTO_NONE; // Running fast forward (for the UI thread)
+static _Atomic uint32_t goto_state_gen    = 0;             // Reached generation of the fast forward
+static int              wake_pipe[2] = {-1, -1}; // Wakes up the simulation thread for new commands
+
+// Shadow values of the UI thread (send commands only on changes)
+static uint8_t  ui_speed   = 0xFF;
+static uint8_t  ui_run     = 0;
+static uint8_t  ui_reverse = 0;
+static uint32_t ui_init    = 0;
+static uint32_t ui_save    = 0;
+
+// State of the simulation thread
+static uint8_t  speed   = 0;
+static uint8_t  running = 0;
+static uint8_t  reverse = 0;
+static uint32_t goto_target = SIM_GOTO_NONE;
+static uint8_t  goto_end_detected = 0; // End was already detected at the start of the fast forward
+
+// Time for one batch of the fast forward (commands are handled in between)
+#define SIM_GOTO_BATCH_NS (50 * 1000 * 1000)
+
+// Snapshot (set before the start of the simulation thread)
+static const char *snapshot_path = NULL;
+static uint32_t    autosave_ms   = 0;
+static uint64_t    autosave_next = 0;
+
+
+
+// Send a command to the simulation thread
+static void sim_send(sim_cmd_t cmd, uint32_t arg)
+{
+    uint32_t head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+
+    // Queue full? -> Wait for the simulation thread (should never happen)
+    while((head - atomic_load_explicit(&queue_tail, memory_order_acquire)) >= SIM_QUEUE_LEN)
+        sched_yield();
+
+    queue[head % SIM_QUEUE_LEN].cmd = cmd;
+    queue[head % SIM_QUEUE_LEN].arg = arg;
+    atomic_store_explicit(&queue_head, head + 1, memory_order_release);
+
+    // Wake up the simulation thread (if already started)
+    if((wake_pipe[1] >= 0) && (write(wake_pipe[1], "", 1) < 0))
+    {
+        // Pipe is full -> Thread will wake up anyway
+    }
+}
+
+
+
+// Function to start (target) or stop (SIM_GOTO_NONE) a fast forward (simulation thread)
+static void sim_goto_set(uint32_t target)
+{
+    if((target == SIM_GOTO_NONE) && (goto_target != SIM_GOTO_NONE))
+    {
+        timing_set_speed(running ? speed : 0); // Go on from now with the deadlines of the speed level
+    }
+    goto_target       = target;
+    goto_end_detected = grid_end_detected();
+    atomic_store(&goto_state_gen, grid_get_generation());
+    atomic_store(&goto_state_target, target);
+}
+
+
+
+// Function to calculate the next batch of a fast forward (as fast as possible, without drawing deadlines)
+// -> Ends at the target generation or when the end of the simulation is detected
+static void sim_goto_step(void)
+{
+    uint32_t gen = grid_get_generation();
+    uint8_t  end = grid_end_detected() && ((goto_target == SIM_GOTO_END) || !goto_end_detected);
+
+    if((gen < goto_target) && !end)
+    {
+        grid_update_n(goto_target - gen, SIM_GOTO_BATCH_NS);
+        gen = grid_get_generation();
+        end = grid_end_detected() && ((goto_target == SIM_GOTO_END) || !goto_end_detected);
+    }
+    atomic_store(&goto_state_gen, gen);
+    if((gen >= goto_target) || end)
+    {
+        sim_goto_set(SIM_GOTO_NONE);
+    }
+}
+
+
+
+// Function to jump to a generation (simulation thread)
+// -> Earlier generations are taken from the history, later ones are calculated by a fast forward
+// -> A recording is seeked directly (by frames, skipped generations of the recording are not counted)
+static void sim_goto_start(uint32_t target)
+{
+    uint32_t gen = (replay_is_open() ? replay_get_generation() : grid_get_generation());
+
+    if((target == SIM_GOTO_NONE) || replay_is_open() || stream_is_remote())
+    {
+        sim_goto_set(SIM_GOTO_NONE);
+    }
+    if((target == SIM_GOTO_NONE) || stream_is_remote())
+    {
+        // Fast forward stopped (the generations of a server can not be calculated ahead)
+    }
+    else if(replay_is_open())
+    {
+        int64_t steps = (target == SIM_GOTO_END ? (int64_t)replay_get_frames() : (int64_t)target - gen);
+        if(steps >  INT32_MAX) steps =  INT32_MAX;
+        if(steps < -INT32_MAX) steps = -INT32_MAX;
+        grid_update_replay((int32_t)steps);
+    }
+    else if(target < gen)
+    {
+        sim_goto_set(SIM_GOTO_NONE);
+        grid_rewind(gen - target);
+    }
+    else
+    {
+        sim_goto_set(target);
+    }
+}
+
+
+
+// Handle all queued commands (simulation thread)
+static void sim_handle_cmds(void)
+{
+    uint32_t tail = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+
+    while(tail != atomic_load_explicit(&queue_head, memory_order_acquire))
+    {
+        sim_cmd_entry_t *entry = &queue[tail % SIM_QUEUE_LEN];
+
+        if     (entry->cmd == SIM_CMD_SPEED)
+        {
+            speed = entry->arg;
+            timing_set_speed(running ? speed : 0);
+        }
+        else if(entry->cmd == SIM_CMD_SIZE)
+        {
+            grid_set_size(entry->arg >> 16, entry->arg & 0xFFFF);
+        }
+        else if(entry->cmd == SIM_CMD_INIT)
+        {
+            grid_init(entry->arg);
+            sim_goto_set(SIM_GOTO_NONE);
+            running = 0;
+            timing_set_speed(0);
+            atomic_fetch_add(&init_ack, 1);
+        }
+        else if(entry->cmd == SIM_CMD_RUN)
+        {
+            running = entry->arg;
+            timing_set_speed(running ? speed : 0);
+        }
+        else if(entry->cmd == SIM_CMD_SAVE)
+        {
+            if(snapshot_path != NULL)
+                snapshot_save(snapshot_path, 1);
+            atomic_fetch_add(&save_ack, 1);
+        }
+        else if(entry->cmd == SIM_CMD_REVERSE)
+        {
+            reverse = entry->arg;
+        }
+        else if(entry->cmd == SIM_CMD_SEEK)
+        {
+            sim_goto_set(SIM_GOTO_NONE);
+            if(replay_is_open())
+                grid_update_replay((int32_t)entry->arg);
+        }
+        else if(entry->cmd == SIM_CMD_REWIND)
+        {
+            sim_goto_set(SIM_GOTO_NONE);
+            if(replay_is_open())
+                grid_update_replay(-(int32_t)entry->arg);
+            else
+                grid_rewind(entry->arg);
+        }
+        else if(entry->cmd == SIM_CMD_GOTO)
+        {
+            sim_goto_start(entry->arg);
+        }
+
+        tail++;
+        atomic_store_explicit(&queue_tail, tail, memory_order_release);
+    }
+}
+
+
+
+// Simulation thread
+static void * sim_thread(void * args)
+{
+    (void)args;
+
+    while(1)
+    {
+        // Handle commands from the UI thread
+        sim_handle_cmds();
+
+        // Calculate next generation at the deadline of the speed level
+        // -> Without running simulation this waits only for the next command
+        // -> Turbo levels calculate a batch of generations as fast as possible (at most one frame long)
+        // -> A recording is played instead of calculated (turbo levels skip frames)
+        // -> The generations of a server are shown instead of calculated (newest one only)
+        // -> A fast forward calculates batches without any deadline
+        if(goto_target != SIM_GOTO_NONE)
+        {
+            sim_goto_step();
+        }
+        else if(timing_wait(wake_pipe[0]))
+        {
+            uint32_t batch = timing_get_batch(speed);
+            if(stream_is_remote())
+                grid_update_remote();
+            else if(replay_is_open())
+                grid_update_replay(reverse ? -(int32_t)batch : (int32_t)batch);
+            else if(batch > 1)
+                grid_update_turbo(batch, TIMING_TURBO_BUDGET_NS);
+            else
+                grid_update();
+        }
+
+        // Autosave in the background (skipped while the last snapshot is still written)
+        if((autosave_ms > 0) && (timing_now_ms() >= autosave_next))
+        {
+            snapshot_save(snapshot_path, 0);
+            autosave_next = timing_now_ms() + autosave_ms;
+        }
+    }
+    return NULL;
+}
+
+
+
+// Start the simulation thread
+void sim_start(void)
+{
+    pthread_t thread;
+
+    if(pipe(wake_pipe))
+    {
+        exit(1);
+    }
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+    autosave_next = timing_now_ms() + autosave_ms;
+
+    if(pthread_create(&thread, NULL, sim_thread, NULL))
+    {
+        exit(1);
+    }
+    pthread_detach(thread);
+}
+
+
+
+// Set the speed level (0: Stop ... SPEED_MAX)
+void sim_set_speed(uint8_t speed)
+{
+    if(speed != ui_speed)
+    {
+        sim_send(SIM_CMD_SPEED, speed);
+        ui_speed = speed;
+    }
+}
+
+
+
+// Set the grid size
+void sim_set_size(uint16_t width, uint16_t height)
+{
+    sim_send(SIM_CMD_SIZE, ((uint32_t)width << 16) | height);
+}
+
+
+
+// Initialize the grid with a pattern (stops the generation steps)
+void sim_init(initpattern_t pattern)
+{
+    sim_send(SIM_CMD_INIT, pattern);
+    ui_init++;
+    ui_run = 0;
+}
+
+
+
+// Start (1) or stop (0) the generation steps
+void sim_run(uint8_t run)
+{
+    if(run != ui_run)
+    {
+        sim_send(SIM_CMD_RUN, run);
+        ui_run = run;
+    }
+}
+
+
+
+// Return "1" if the last sim_init() has been processed by the simulation thread
+uint8_t sim_init_done(void)
+{
+    return (atomic_load(&init_ack) == ui_init);
+}
+
+
+
+// Set the snapshot file for sim_save() and the autosave interval (0: no autosave)
+// -> Has to be called before sim_start()
+void sim_set_snapshot(const char * path, uint32_t autosave_s)
+{
+    snapshot_path = path;
+    autosave_ms   = (path != NULL ? autosave_s * 1000 : 0);
+}
+
+
+
+// Save a snapshot and wait until the file has been written
+void sim_save(void)
+{
+    sim_send(SIM_CMD_SAVE, 0);
+    ui_save++;
+    while(atomic_load(&save_ack) != ui_save)
+        usleep(1000);
+}
+
+
+
+// Play a recording backwards (1) or forwards (0)
+void sim_set_reverse(uint8_t reverse)
+{
+    if(reverse != ui_reverse)
+    {
+        sim_send(SIM_CMD_REVERSE, reverse);
+        ui_reverse = reverse;
+    }
+}
+
+
+
+// Seek in a recording by a number of frames (negative: backwards)
+void sim_seek(int32_t frames)
+{
+    sim_send(SIM_CMD_SEEK, (uint32_t)frames);
+}
+
+
+
+// Go back some generations (from the history or in a recording)
+void sim_rewind(uint32_t gens)
+{
+    sim_send(SIM_CMD_REWIND, gens);
+}
+
+
+
+// Jump to a generation (SIM_GOTO_END: Fast forward until the end is detected)
+// -> Later generations are calculated as fast as possible, see sim_goto_get()
+void sim_goto(uint32_t generation)
+{
+    atomic_store(&goto_state_target, generation); // Shown at once (reset by the simulation thread, if not needed)
+    sim_send(SIM_CMD_GOTO, generation);
+}
+
+
+
+// Get the target of the running fast forward (SIM_GOTO_NONE: No fast forward) and the reached generation
+uint32_t sim_goto_get(uint32_t * generation)
+{
+    if(generation != NULL)
+        *generation = atomic_load(&goto_state_gen);
+    return atomic_load(&goto_state_target);
+}
@@ -0,0 +1,61 @@
+
+// File:    sim.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Simulation thread for the Game of Life (controlled by commands from the UI thread)
+
+#ifndef __SIM_H
+#define __SIM_H
+
+#include <stdint.h>
+#include "grid.h"
+
+#define SIM_GOTO_NONE 0          // No fast forward
+#define SIM_GOTO_END  UINT32_MAX // Fast forward until the end is detected
+
+
+
+// Start the simulation thread
+void sim_start(void);
+
+// Set the speed level (0: Stop ... SPEED_MAX)
+void sim_set_speed(uint8_t speed);
+
+// Set the grid size
+void sim_set_size(uint16_t width, uint16_t height);
+
+// Initialize the grid with a pattern (stops the generation steps)
+void sim_init(initpattern_t pattern);
+
+// Start (1) or stop (0) the generation steps
+void sim_run(uint8_t run);
+
+// Return "1" if the last sim_init() has been processed by the simulation thread
+uint8_t sim_init_done(void);
+
+// Set the snapshot file for sim_save() and the autosave interval (0: no autosave)
+// -> Has to be called before sim_start()
+void sim_set_snapshot(const char * path, uint32_t autosave_s);
+
+// Save a snapshot and wait until the file has been written
+void sim_save(void);
+
+// Play a recording backwards (1) or forwards (0)
+void sim_set_reverse(uint8_t reverse);
+
+// Seek in a recording by a number of frames (negative: backwards)
+void sim_seek(int32_t frames);
+
+// Go back some generations (from the history or in a recording)
+void sim_rewind(uint32_t gens);
+
+// Jump to a generation (SIM_GOTO_END: Fast forward until the end is detected)
+// -> Later generations are calculated as fast as possible, see sim_goto_get()
+void sim_goto(uint32_t generation);
+
+// Get the target of the running fast forward (SIM_GOTO_NONE: No fast forward) and the reached generation
+uint32_t sim_goto_get(uint32_t * generation);
+
+
+
+#endif // __SIM_H
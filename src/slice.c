@@ -0,0 +1,354 @@
+
+// File:    slice.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Bit-sliced simulation of 64 small universes in lockstep.
+//          Every cell is one 64-bit word, bit n is the cell of universe n. The neighbors
+//          are counted with bitwise adders, so one pass over the words calculates the
+//          next generation of all universes at once. The universes are independent:
+//          Every universe has its own start, its own count of living cells and its own
+//          end detection, an ended universe can be started again with new cells while
+//          the others go on.
+//
+//          End detection: The last SLICE_LAG generations are kept in a ring. Every new
+//          generation is compared with the one SLICE_LAG generations before (the slot in
+//          the ring which is overwritten). A universe without any difference is periodic
+//          from that generation on (the rules are deterministic), so the end and the first
+//          generation of the end state are exact for all periods which divide SLICE_LAG.
+//          Other periods (e.g. gliders on the torus) are found with a snapshot which is
+//          taken every SLICE_SNAPSHOT generations, then the first generation of the end
+//          state is only known to be before the snapshot (see slice_is_exact()). It can be
+//          found exactly by running the universe a second time with a delay of the period
+//          in another universe (see slice_compare()).
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "slice.h"
+#include "grid.h"
+
+#define SLICE_SNAPSHOT 1024 // Generations between two snapshots (longest period, which is detected)
+#define SLICE_COUNT_BITS 20 // Bits of the counters for the living cells (SLICE_SIZE_MAX^2 cells)
+
+static uint16_t width  = 0;
+static uint16_t height = 0;
+static uint64_t *ring[SLICE_LAG];  // Last generations (ring[gen % SLICE_LAG])
+static uint64_t *snapshot = NULL;
+static uint64_t *sum_lr   = NULL;  // Temporary sums of a row: Three vertical cells (2 bits)
+static uint64_t *sum_ud   = NULL;  //                          Two vertical cells (2 bits)
+static uint32_t gen       = 0;     // Generations since slice_set_size()
+static uint32_t snapshot_gen = 0;
+static uint64_t snapshot_valid = 0; // Universes which have been started before the snapshot
+static uint64_t ended     = 0;
+
+// State of every universe
+static uint32_t start[SLICE_UNIVERSES];     // Value of "gen" at the start
+static uint32_t alive[SLICE_UNIVERSES];
+static uint32_t max_alive[SLICE_UNIVERSES];
+static uint32_t lifespan[SLICE_UNIVERSES];
+static uint32_t period[SLICE_UNIVERSES];
+static uint64_t exact = 0; // Universes with an exact lifespan
+
+
+
+// Set the size of all universes (all universes are cleared)
+// -> Returns "1" if the size is valid and the memory could be allocated
+uint8_t slice_set_size(uint16_t w, uint16_t h)
+{
+    size_t size = (size_t)w * h * sizeof(uint64_t);
+
+    if((w < 3) || (h < 3) || (w > SLICE_SIZE_MAX) || (h > SLICE_SIZE_MAX))
+    {
+        return 0;
+    }
+    for(uint8_t i=0; i<SLICE_LAG; i++)
+    {
+        free(ring[i]);
+        ring[i] = calloc(1, size);
+        if(ring[i] == NULL)
+        {
+            return 0;
+        }
+    }
+    free(snapshot);
+    free(sum_lr);
+    free(sum_ud);
+    snapshot = calloc(1, size);
+    sum_lr   = calloc(2 * w, sizeof(uint64_t));
+    sum_ud   = calloc(2 * w, sizeof(uint64_t));
+    if((snapshot == NULL) || (sum_lr == NULL) || (sum_ud == NULL))
+    {
+        return 0;
+    }
+
+    width  = w;
+    height = h;
+    gen    = 0;
+    snapshot_gen   = 0;
+    snapshot_valid = 0;
+    ended  = 0;
+    memset(start,     0, sizeof(start));
+    memset(alive,     0, sizeof(alive));
+    memset(max_alive, 0, sizeof(max_alive));
+    return 1;
+}
+
+
+
+// Set the cells of a universe (grid[x][y] for the size of the universes) and start it at generation 0
+void slice_set_universe(uint8_t universe, const grid_t * grid)
+{
+    uint64_t *cells = ring[gen % SLICE_LAG];
+    uint64_t bit    = (uint64_t)1 << universe;
+    uint32_t cnt    = 0;
+
+    if((universe >= SLICE_UNIVERSES) || (cells == NULL))
+    {
+        return;
+    }
+    for(uint16_t y=0; y<height; y++)
+    {
+        for(uint16_t x=0; x<width; x++)
+        {
+            uint64_t *cell = &cells[(uint32_t)y * width + x];
+            *cell = (grid[x][y] ? (*cell | bit) : (*cell & ~bit));
+            cnt  += (grid[x][y] ? 1 : 0);
+        }
+    }
+    start[universe]     = gen;
+    alive[universe]     = cnt;
+    max_alive[universe] = cnt;
+    lifespan[universe]  = 0;
+    period[universe]    = 0;
+    ended          &= ~bit;
+    exact          &= ~bit;
+    snapshot_valid &= ~bit; // The snapshot has cells of the universe before
+}
+
+
+
+// Function to get the smallest period of a universe, which divides a found period
+// -> Only periods below SLICE_LAG can be checked with the ring, otherwise the found period is returned
+static uint32_t slice_find_period(uint8_t universe, uint32_t period_found)
+{
+    const uint64_t *cells = ring[gen % SLICE_LAG];
+    uint64_t       bit    = (uint64_t)1 << universe;
+    uint32_t       size   = (uint32_t)width * height;
+
+    for(uint32_t d=1; (d < period_found) && (d < SLICE_LAG) && (d <= gen - start[universe]); d++)
+    {
+        if((period_found % d) != 0)
+        {
+            continue;
+        }
+        const uint64_t *prev = ring[(gen + SLICE_LAG - d) % SLICE_LAG];
+        uint32_t       i     = 0;
+        while((i < size) && !((cells[i] ^ prev[i]) & bit))
+            i++;
+        if(i == size)
+        {
+            return d;
+        }
+    }
+    return period_found;
+}
+
+
+
+// Function to calculate the next generation of all universes
+void slice_update(void)
+{
+    const uint64_t *cur  = ring[gen % SLICE_LAG];
+    uint64_t       *next = ring[(gen + 1) % SLICE_LAG]; // Generation SLICE_LAG before the next one
+    uint64_t       diff_lag  = 0; // Universes which differ from the generation SLICE_LAG before
+    uint64_t       diff_snap = 0; // Universes which differ from the snapshot
+    uint64_t       count[SLICE_COUNT_BITS] = {0}; // Bit-sliced counters of the living cells
+
+    if(cur == NULL)
+    {
+        return;
+    }
+
+    for(uint16_t y=0; y<height; y++)
+    {
+        const uint64_t *up   = &cur[(uint32_t)((y + height - 1) % height) * width];
+        const uint64_t *row  = &cur[(uint32_t)y * width];
+        const uint64_t *down = &cur[(uint32_t)((y + 1) % height) * width];
+        uint64_t       *out  = &next[(uint32_t)y * width];
+        const uint64_t *snap = &snapshot[(uint32_t)y * width];
+
+        // Vertical sums of every column: With the cell itself (for the left and right neighbors) and without
+        for(uint16_t x=0; x<width; x++)
+        {
+            uint64_t u = up[x], c = row[x], d = down[x];
+            sum_lr[2*x]   = u ^ c ^ d;
+            sum_lr[2*x+1] = (u & c) | (d & (u ^ c));
+            sum_ud[2*x]   = u ^ d;
+            sum_ud[2*x+1] = u & d;
+        }
+
+        for(uint16_t x=0; x<width; x++)
+        {
+            uint16_t xl = (x > 0 ? x - 1 : width - 1);
+            uint16_t xr = (x + 1 < width ? x + 1 : 0);
+
+            // Left + right column (0..6)
+            uint64_t l0 = sum_lr[2*xl], l1 = sum_lr[2*xl+1];
+            uint64_t r0 = sum_lr[2*xr], r1 = sum_lr[2*xr+1];
+            uint64_t a0 = l0 ^ r0;
+            uint64_t c0 = l0 & r0;
+            uint64_t a1 = l1 ^ r1 ^ c0;
+            uint64_t a2 = (l1 & r1) | (c0 & (l1 ^ r1));
+
+            // + upper and lower cell (0..8, only the lower three bits are needed for 2 and 3)
+            uint64_t p0 = sum_ud[2*x], p1 = sum_ud[2*x+1];
+            uint64_t b0 = a0 ^ p0;
+            uint64_t k0 = a0 & p0;
+            uint64_t b1 = a1 ^ p1 ^ k0;
+            uint64_t k1 = (a1 & p1) | (k0 & (a1 ^ p1));
+            uint64_t b2 = a2 ^ k1;
+
+            // Alive with 3 neighbors or with 2 neighbors and alive before
+            uint64_t cell = b1 & ~b2 & (b0 | row[x]);
+
+            diff_lag  |= cell ^ out[x];
+            diff_snap |= cell ^ snap[x];
+            out[x] = cell;
+
+            // Count the living cells (ripple carry through the bit-sliced counters)
+            uint64_t carry = cell;
+            for(uint8_t b=0; carry; b++)
+            {
+                uint64_t t = count[b] & carry;
+                count[b] ^= carry;
+                carry = t;
+            }
+        }
+    }
+    gen++;
+
+    // Statistics and end detection of every running universe
+    for(uint8_t u=0; u<SLICE_UNIVERSES; u++)
+    {
+        uint64_t bit = (uint64_t)1 << u;
+        uint32_t cnt = 0;
+
+        if(ended & bit)
+        {
+            continue;
+        }
+        for(uint8_t b=0; b<SLICE_COUNT_BITS; b++)
+            cnt |= ((count[b] >> u) & 1) << b;
+        alive[u] = cnt;
+        if(cnt > max_alive[u])
+            max_alive[u] = cnt;
+
+        if((gen - start[u] >= SLICE_LAG) && !(diff_lag & bit))
+        {
+            // Same as SLICE_LAG generations before -> Periodic from that generation on
+            ended      |= bit;
+            exact      |= bit;
+            lifespan[u] = gen - start[u] - SLICE_LAG;
+            period[u]   = slice_find_period(u, SLICE_LAG);
+        }
+        else if((snapshot_valid & bit) && !(diff_snap & bit))
+        {
+            // Same as the snapshot -> Periodic at least from the snapshot on
+            // (periods which divide SLICE_LAG are left to the exact detection above)
+            uint32_t p = slice_find_period(u, gen - snapshot_gen);
+            if((SLICE_LAG % p) != 0)
+            {
+                ended      |= bit;
+                lifespan[u] = snapshot_gen - start[u];
+                period[u]   = p;
+            }
+        }
+    }
+
+    // Next snapshot for the longer periods
+    if((gen % SLICE_SNAPSHOT) == 0)
+    {
+        memcpy(snapshot, ring[gen % SLICE_LAG], (size_t)width * height * sizeof(uint64_t));
+        snapshot_gen   = gen;
+        snapshot_valid = ~(uint64_t)0;
+    }
+}
+
+
+
+// Get the universes whose end has been detected (bit 0: universe 0)
+uint64_t slice_get_ended(void)
+{
+    return ended;
+}
+
+
+
+// Return "1" if the lifespan of an ended universe is exact (otherwise the end state began before)
+uint8_t slice_is_exact(uint8_t universe)
+{
+    return (universe < SLICE_UNIVERSES ? (exact >> universe) & 1 : 0);
+}
+
+
+
+// Return "1" if two universes have the same cells
+uint8_t slice_compare(uint8_t universe1, uint8_t universe2)
+{
+    const uint64_t *cells = ring[gen % SLICE_LAG];
+    uint32_t       size   = (uint32_t)width * height;
+
+    if((universe1 >= SLICE_UNIVERSES) || (universe2 >= SLICE_UNIVERSES) || (cells == NULL))
+    {
+        return 0;
+    }
+    for(uint32_t i=0; i<size; i++)
+    {
+        if(((cells[i] >> universe1) ^ (cells[i] >> universe2)) & 1)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+
+// Get the generation of a universe since its start
+uint32_t slice_get_generation(uint8_t universe)
+{
+    return (universe < SLICE_UNIVERSES ? gen - start[universe] : 0);
+}
+
+
+
+// Get count of cells which are alive in a universe
+uint32_t slice_get_alive(uint8_t universe)
+{
+    return (universe < SLICE_UNIVERSES ? alive[universe] : 0);
+}
+
+
+
+// Get the largest count of living cells of a universe since its start
+uint32_t slice_get_max_alive(uint8_t universe)
+{
+    return (universe < SLICE_UNIVERSES ? max_alive[universe] : 0);
+}
+
+
+
+// Get the first generation of the end state of a universe (only valid after the end detection)
+uint32_t slice_get_lifespan(uint8_t universe)
+{
+    return (universe < SLICE_UNIVERSES ? lifespan[universe] : 0);
+}
+
+
+
+// Get the period of the end state of a universe (only valid after the end detection)
+uint32_t slice_get_period(uint8_t universe)
+{
+    return (universe < SLICE_UNIVERSES ? period[universe] : 0);
+}
@@ -0,0 +1,55 @@
+
+// File:    slice.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Bit-sliced simulation of 64 small universes in lockstep (see slice.c)
+
+#ifndef __SLICE_H
+#define __SLICE_H
+
+#include <stdint.h>
+#include "grid.h"
+
+#define SLICE_UNIVERSES 64  // One bit of every word per universe
+#define SLICE_SIZE_MAX  512 // Maximum width and height of the universes
+#define SLICE_LAG       60  // Generations for the end detection (periods which divide it are detected at once)
+
+
+
+// Set the size of all universes (all universes are cleared)
+// -> Returns "1" if the size is valid and the memory could be allocated
+uint8_t slice_set_size(uint16_t width, uint16_t height);
+
+// Set the cells of a universe (grid[x][y] for the size of the universes) and start it at generation 0
+void slice_set_universe(uint8_t universe, const grid_t * grid);
+
+// Function to calculate the next generation of all universes
+void slice_update(void);
+
+// Get the universes whose end has been detected (bit 0: universe 0)
+uint64_t slice_get_ended(void);
+
+// Return "1" if the lifespan of an ended universe is exact (otherwise the end state began before)
+uint8_t slice_is_exact(uint8_t universe);
+
+// Return "1" if two universes have the same cells
+uint8_t slice_compare(uint8_t universe1, uint8_t universe2);
+
+// Get the generation of a universe since its start
+uint32_t slice_get_generation(uint8_t universe);
+
+// Get count of cells which are alive in a universe
+uint32_t slice_get_alive(uint8_t universe);
+
+// Get the largest count of living cells of a universe since its start
+uint32_t slice_get_max_alive(uint8_t universe);
+
+// Get the first generation of the end state of a universe (only valid after the end detection)
+uint32_t slice_get_lifespan(uint8_t universe);
+
+// Get the period of the end state of a universe (only valid after the end detection)
+uint32_t slice_get_period(uint8_t universe);
+
+
+
+#endif // __SLICE_H
@@ -0,0 +1,262 @@
+
+// File:    snapshot.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Binary snapshots of the simulation (save in background and resume).
+//          A snapshot is a fixed header with the state of the simulation, followed by the
+//          packed grid (1 bit per cell). It is loaded by mapping the file into memory, there
+//          is nothing to parse. The header is written with the layout of this build, a
+//          snapshot of another version or machine is rejected by the magic and version.
+//          For saving, the simulation thread forks. The child process gets a copy-on-write
+//          view of the grid and writes the file, while the simulation goes on at once.
+//          With the shared memory export the frames of the grid are shared with the child
+//          (no copy-on-write), so then the grid is packed before the fork.
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "config.h"
+#include "snapshot.h"
+#include "grid.h"
+#include "end_det.h"
+#include "shm_out.h"
+#include "debug_output.h"
+
+#define SNAPSHOT_MAGIC   "NCGOLSNP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_RULE    "B3/S23"
+
+typedef struct
+{
+    char            magic[8];
+    uint32_t        version;
+    uint32_t        header_size;   // Offset of the packed grid
+    char            rule[16];
+    grid_state_t    grid;
+    end_det_state_t end_det;
+} snapshot_header_t;
+
+static const snapshot_header_t *map = NULL; // Mapped snapshot file
+static size_t      map_size = 0;
+static const char *name  = "";
+static const char *error = "";
+static pid_t       save_pid = -1;  // Process which writes the last snapshot
+static uint8_t     save_bits[GRID_PACKED_SIZE(GRID_WIDTH_MAX, GRID_HEIGHT_MAX)]; // Packed grid (only written by the forked process)
+
+
+
+// Open a snapshot file (the file stays mapped into memory for every restart of the snapshot)
+// -> Returns "1" if the file is a valid snapshot, otherwise see snapshot_get_error()
+uint8_t snapshot_open(const char * path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0)
+    {
+        error = "File can not be opened";
+        return 0;
+    }
+    if((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(snapshot_header_t)))
+    {
+        error = "File is too small";
+        close(fd);
+        return 0;
+    }
+    map_size = st.st_size;
+    map      = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        map   = NULL;
+        error = "File can not be mapped";
+        return 0;
+    }
+
+    if(    (memcmp(map->magic, SNAPSHOT_MAGIC, sizeof(map->magic)) != 0)
+        || (map->version     != SNAPSHOT_VERSION)
+        || (map->header_size != sizeof(snapshot_header_t))
+      )
+    {
+        error = "No snapshot of this version";
+    }
+    else if(strncmp(map->rule, SNAPSHOT_RULE, sizeof(map->rule)) != 0)
+    {
+        error = "Rule is not supported";
+    }
+    else if(    (map->grid.width  > GRID_WIDTH_MAX) || (map->grid.height > GRID_HEIGHT_MAX)
+             || (map_size < map->header_size + GRID_PACKED_SIZE(map->grid.width, map->grid.height))
+           )
+    {
+        error = "Invalid grid size";
+    }
+    else
+    {
+        name = strrchr(path, '/');
+        name = (name != NULL ? name + 1 : path);
+        return 1;
+    }
+
+    munmap((void *)map, map_size);
+    map = NULL;
+    return 0;
+}
+
+
+
+// Get the reason why the snapshot could not be opened
+const char * snapshot_get_error(void)
+{
+    return error;
+}
+
+
+
+// Get the name of the opened snapshot (without path)
+const char * snapshot_get_name(void)
+{
+    return name;
+}
+
+
+
+// Set the cells of the snapshot to the grid center
+void snapshot_set_to_grid(grid_t * grid)
+{
+    if((grid == 0) || (map == NULL))
+    {
+        return;
+    }
+    grid_unpack(grid, (const uint8_t *)map + map->header_size, map->grid.width, map->grid.height);
+}
+
+
+
+// Get the state of the simulation in the snapshot
+// -> Returns "1" if a snapshot is opened
+uint8_t snapshot_get_state(grid_state_t * state, end_det_state_t * end_det_state)
+{
+    if(map == NULL)
+    {
+        return 0;
+    }
+    *state         = map->grid;
+    *end_det_state = map->end_det;
+    return 1;
+}
+
+
+
+// Function to write all bytes into a file
+static uint8_t snapshot_write_all(int fd, const void * buf, size_t len)
+{
+    const uint8_t *p = buf;
+
+    while(len > 0)
+    {
+        ssize_t ret = write(fd, p, len);
+        if(ret <= 0)
+            return 0;
+        p   += ret;
+        len -= ret;
+    }
+    return 1;
+}
+
+
+
+// Function to write the snapshot file (via a temporary file, so there is always a complete snapshot)
+// -> Only uses functions which are allowed in a forked child of a multi-threaded process
+// -> "packed": The grid has already been packed into "save_bits"
+static uint8_t snapshot_write(const char * path, const char * path_tmp, const snapshot_header_t * header, uint8_t packed)
+{
+    uint32_t size = GRID_PACKED_SIZE(header->grid.width, header->grid.height);
+    uint8_t  ok;
+    int      fd;
+
+    if(!packed)
+        grid_pack(grid_get(), header->grid.width, header->grid.height, save_bits);
+
+    fd = open(path_tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        return 0;
+    }
+    ok = snapshot_write_all(fd, header, sizeof(*header)) && snapshot_write_all(fd, save_bits, size) && (fsync(fd) == 0);
+    close(fd);
+    if(ok && (rename(path_tmp, path) == 0))
+    {
+        return 1;
+    }
+    unlink(path_tmp);
+    return 0;
+}
+
+
+
+// Save the current generation as snapshot (only for the simulation thread)
+// -> The file is written by a forked process in the background (copy-on-write of the grid)
+// -> With "wait" the function returns after the file has been written
+// -> Returns "1" if the snapshot has been started (or written with "wait")
+uint8_t snapshot_save(const char * path, uint8_t wait)
+{
+    snapshot_header_t header;
+    char              path_tmp[1024];
+    int               status;
+    uint8_t           packed = 0;
+
+    // Last snapshot still running? -> Skip this one (or wait for it)
+    if(save_pid > 0)
+    {
+        if(waitpid(save_pid, &status, (wait ? 0 : WNOHANG)) == 0)
+            return 0;
+        save_pid = -1;
+    }
+
+    // Prepare everything before the fork (no allocations in the child)
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version     = SNAPSHOT_VERSION;
+    header.header_size = sizeof(header);
+    strncpy(header.rule, SNAPSHOT_RULE, sizeof(header.rule));
+    grid_get_state(&header.grid);
+    grid_get_end_det_state(&header.end_det);
+    if(snprintf(path_tmp, sizeof(path_tmp), "%s.tmp", path) >= (int)sizeof(path_tmp))
+    {
+        return 0;
+    }
+
+    // Frames in shared memory (see shm_out_open()) are not copied on write for the child, the
+    // simulation would overwrite the current one within two generations -> Pack it before the fork
+    if(shm_out_is_open())
+    {
+        grid_pack(grid_get(), header.grid.width, header.grid.height, save_bits);
+        packed = 1;
+    }
+
+    #if (WITH_DEBUG_OUTPUT)
+        debug_printf("Snapshot of cycle %u to %s\n", header.grid.cycle_counter, path);
+    #endif
+
+    pid_t pid = fork();
+    if(pid == 0)      // Child -> Write the file and exit without any cleanup of the parent
+    {
+        _exit(snapshot_write(path, path_tmp, &header, packed) ? 0 : 1);
+    }
+    else if(pid < 0)  // No fork possible -> Write the file directly
+    {
+        return snapshot_write(path, path_tmp, &header, packed);
+    }
+
+    if(wait)
+    {
+        return (waitpid(pid, &status, 0) == pid) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+    }
+    save_pid = pid;
+    return 1;
+}
@@ -0,0 +1,41 @@
+
+// File:    snapshot.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Binary snapshots of the simulation (save in background and resume)
+
+#ifndef __SNAPSHOT_H
+#define __SNAPSHOT_H
+
+#include <stdint.h>
+#include "grid.h"
+#include "end_det.h"
+
+
+
+// Open a snapshot file (the file stays mapped into memory for every restart of the snapshot)
+// -> Returns "1" if the file is a valid snapshot, otherwise see snapshot_get_error()
+uint8_t snapshot_open(const char * path);
+
+// Get the reason why the snapshot could not be opened
+const char * snapshot_get_error(void);
+
+// Get the name of the opened snapshot (without path)
+const char * snapshot_get_name(void);
+
+// Set the cells of the snapshot to the grid center
+void snapshot_set_to_grid(grid_t * grid);
+
+// Get the state of the simulation in the snapshot
+// -> Returns "1" if a snapshot is opened
+uint8_t snapshot_get_state(grid_state_t * state, end_det_state_t * end_det_state);
+
+// Save the current generation as snapshot (only for the simulation thread)
+// -> The file is written by a forked process in the background (copy-on-write of the grid)
+// -> With "wait" the function returns after the file has been written
+// -> Returns "1" if the snapshot has been started (or written with "wait")
+uint8_t snapshot_save(const char * path, uint8_t wait);
+
+
+
+#endif // __SNAPSHOT_H
@@ -0,0 +1,641 @@
+
+// File:    stream.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Streaming of the generations over TCP to viewers ("--serve" and "--connect").
+//          The stream has the format of a recording (see recorder.h): The file header and
+//          then one record per generation with the runs of the changed bytes of the packed
+//          grid. A viewer gets a keyframe at first and after a change of the grid size.
+//          The simulation thread only packs the grid and hands it over to the server thread
+//          (triple buffering, only pointers are swapped under the mutex). The server thread
+//          keeps the last sent generation of every viewer and sends the delta to the newest
+//          generation as soon as everything before has been sent. So a slow viewer gets
+//          fewer generations with larger deltas, it never slows down the simulation or the
+//          other viewers.
+//          The viewer has a receiver thread, which applies the deltas. The simulation
+//          thread takes the newest generation from it instead of calculating one.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "config.h"
+#include "stream.h"
+#include "recorder.h"
+#include "grid.h"
+
+#define STREAM_BITS_MAX GRID_PACKED_SIZE(GRID_WIDTH_MAX, GRID_HEIGHT_MAX)
+#define STREAM_OUT_MAX  (sizeof(recorder_record_t) + RECORDER_RUNS_MAX(STREAM_BITS_MAX))
+#define STREAM_SNDBUF   (64 * 1024) // Small send buffer for a viewer, so a slow viewer gets newer generations sooner
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SO_NOSIGPIPE is set for the sockets instead
+#endif
+
+// Packed generation
+typedef struct
+{
+    uint8_t  *bits;
+    uint32_t generation;
+    uint16_t width;
+    uint16_t height;
+} stream_frame_t;
+
+// Viewer of the server
+typedef struct
+{
+    int      fd;       // -1: Free
+    uint8_t  *bits;    // Last sent generation (packed)
+    uint16_t width;    // Size of the last sent generation (0: Nothing sent yet -> Keyframe)
+    uint16_t height;
+    uint32_t seq;      // Sequence number of the last sent generation
+    uint8_t  *out;     // Data which is being sent
+    uint32_t out_len;
+    uint32_t out_pos;
+} stream_client_t;
+
+// Server
+static uint8_t          serving = 0;
+static int              listen_fd = -1;
+static int              wake_pipe[2] = {-1, -1};
+static _Atomic uint8_t  wake_pending = 0;
+static _Atomic uint32_t client_cnt   = 0;
+static _Atomic uint8_t  server_stop  = 0;
+static pthread_t        server;
+static pthread_mutex_t  server_mutex = PTHREAD_MUTEX_INITIALIZER;
+static stream_frame_t   frames[3];
+static stream_frame_t   *frame_fill   = &frames[0]; // Packed by the simulation thread
+static stream_frame_t   *frame_ready  = &frames[1]; // Newest generation for the server thread
+static stream_frame_t   *frame_newest = &frames[2]; // Taken by the server thread
+static uint32_t         ready_seq  = 0;             // Sequence number of frame_ready (0: None)
+static uint32_t         newest_seq = 0;             // Sequence number of frame_newest (0: None)
+static stream_client_t  clients[STREAM_CLIENTS_MAX];
+
+// Viewer
+static uint8_t          remote = 0;
+static int              conn_fd = -1;
+static uint8_t          connected = 0;
+static pthread_t        receiver;
+static pthread_mutex_t  remote_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   remote_cond  = PTHREAD_COND_INITIALIZER;
+static stream_frame_t   remote_frame;               // Newest received generation
+static uint8_t          remote_fresh = 0;           // remote_frame has not been taken yet
+static char             remote_name[64];
+
+
+
+// Function to set the socket options of a stream
+static void stream_set_socket(int fd, uint8_t nonblocking)
+{
+    if(nonblocking)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    #if(defined SO_NOSIGPIPE)
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+    #endif
+}
+
+
+
+// Function to close the connection to a viewer
+static void stream_client_close(stream_client_t * c)
+{
+    close(c->fd);
+    c->fd = -1;
+
+    // Without viewers the simulation thread does not hand over any generations
+    // -> A new viewer waits for the next generation instead of getting an old one
+    if(atomic_fetch_sub(&client_cnt, 1) == 1)
+    {
+        pthread_mutex_lock(&server_mutex);
+        ready_seq  = 0;
+        newest_seq = 0;
+        pthread_mutex_unlock(&server_mutex);
+    }
+}
+
+
+
+// Function to send the pending data to a viewer
+// -> Returns "0" if the connection has been closed
+static uint8_t stream_client_send(stream_client_t * c)
+{
+    while(c->out_pos < c->out_len)
+    {
+        ssize_t n = send(c->fd, &c->out[c->out_pos], c->out_len - c->out_pos, MSG_NOSIGNAL);
+        if(n > 0)
+        {
+            c->out_pos += n;
+        }
+        else if((n < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        else
+        {
+            return ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)));
+        }
+    }
+    return 1;
+}
+
+
+
+// Function to encode the newest generation for a viewer (delta to the last sent one)
+static void stream_client_encode(stream_client_t * c)
+{
+    recorder_record_t rec;
+    uint32_t          size     = GRID_PACKED_SIZE(frame_newest->width, frame_newest->height);
+    uint8_t           keyframe = ((c->width != frame_newest->width) || (c->height != frame_newest->height));
+
+    memset(&rec, 0, sizeof(rec));
+    rec.generation = frame_newest->generation;
+    rec.width      = frame_newest->width;
+    rec.height     = frame_newest->height;
+    rec.type       = (keyframe ? RECORDER_TYPE_KEYFRAME : RECORDER_TYPE_DELTA);
+    rec.size       = recorder_encode_runs(frame_newest->bits, (keyframe ? NULL : c->bits), size, &c->out[sizeof(rec)]);
+    memcpy(c->out, &rec, sizeof(rec));
+    c->out_len = sizeof(rec) + rec.size;
+    c->out_pos = 0;
+
+    memcpy(c->bits, frame_newest->bits, size);
+    c->width  = frame_newest->width;
+    c->height = frame_newest->height;
+    c->seq    = newest_seq;
+}
+
+
+
+// Function to accept a new viewer
+static void stream_accept(void)
+{
+    recorder_file_header_t header;
+    int                    fd = accept(listen_fd, NULL, NULL);
+
+    if(fd < 0)
+    {
+        return;
+    }
+    for(uint8_t i=0; i<STREAM_CLIENTS_MAX; i++)
+    {
+        stream_client_t *c = &clients[i];
+        if(c->fd >= 0)
+        {
+            continue;
+        }
+        if(c->bits == NULL)
+            c->bits = malloc(STREAM_BITS_MAX);
+        if(c->out == NULL)
+            c->out  = malloc(STREAM_OUT_MAX);
+        if((c->bits == NULL) || (c->out == NULL))
+        {
+            break;
+        }
+        int sndbuf = STREAM_SNDBUF;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        stream_set_socket(fd, 1);
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, RECORDER_MAGIC, sizeof(header.magic));
+        header.version  = RECORDER_VERSION;
+        header.keyframe = 0; // Only at the start and after a change of the size
+        memcpy(c->out, &header, sizeof(header));
+        c->fd      = fd;
+        c->width   = 0;
+        c->height  = 0;
+        c->seq     = 0;
+        c->out_len = sizeof(header);
+        c->out_pos = 0;
+        atomic_fetch_add(&client_cnt, 1);
+        return;
+    }
+    close(fd); // No free slot
+}
+
+
+
+// Server thread (sends the generations to all viewers)
+static void * stream_server(void * args)
+{
+    struct pollfd fds[2 + STREAM_CLIENTS_MAX];
+    uint8_t       idx[STREAM_CLIENTS_MAX]; // Client of fds[2 + i]
+    uint8_t       scratch[256];
+
+    (void)args;
+    while(!atomic_load(&server_stop))
+    {
+        uint8_t cnt = 0;
+
+        fds[0].fd     = wake_pipe[0];
+        fds[0].events = POLLIN;
+        fds[1].fd     = listen_fd;
+        fds[1].events = POLLIN;
+        for(uint8_t i=0; i<STREAM_CLIENTS_MAX; i++)
+        {
+            if(clients[i].fd < 0)
+                continue;
+            fds[2 + cnt].fd     = clients[i].fd;
+            fds[2 + cnt].events = POLLIN | (clients[i].out_pos < clients[i].out_len ? POLLOUT : 0);
+            idx[cnt++] = i;
+        }
+        if(poll(fds, 2 + cnt, -1) < 0)
+        {
+            continue;
+        }
+
+        // Newest generation of the simulation thread
+        if(fds[0].revents & POLLIN)
+        {
+            while(read(wake_pipe[0], scratch, sizeof(scratch)) > 0);
+            atomic_store(&wake_pending, 0);
+            pthread_mutex_lock(&server_mutex);
+            if(ready_seq != newest_seq)
+            {
+                stream_frame_t *frame = frame_newest;
+                frame_newest = frame_ready;
+                frame_ready  = frame;
+                newest_seq   = ready_seq;
+            }
+            pthread_mutex_unlock(&server_mutex);
+        }
+        if(fds[1].revents & POLLIN)
+        {
+            stream_accept();
+        }
+
+        // Data from the viewers is ignored, it only shows a closed connection
+        for(uint8_t i=0; i<cnt; i++)
+        {
+            stream_client_t *c = &clients[idx[i]];
+            if(fds[2 + i].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                ssize_t n = recv(c->fd, scratch, sizeof(scratch), 0);
+                if((n == 0) || ((n < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)))
+                {
+                    stream_client_close(c);
+                }
+            }
+        }
+
+        // Send the newest generation to every viewer which has sent everything before
+        for(uint8_t i=0; i<STREAM_CLIENTS_MAX; i++)
+        {
+            stream_client_t *c = &clients[i];
+            if(c->fd < 0)
+                continue;
+            if(!stream_client_send(c))
+            {
+                stream_client_close(c);
+                continue;
+            }
+            if((c->out_pos == c->out_len) && (newest_seq != 0) && (c->seq != newest_seq))
+            {
+                stream_client_encode(c);
+                if(!stream_client_send(c))
+                    stream_client_close(c);
+            }
+        }
+    }
+
+    for(uint8_t i=0; i<STREAM_CLIENTS_MAX; i++)
+    {
+        if(clients[i].fd >= 0)
+            stream_client_close(&clients[i]);
+    }
+    return NULL;
+}
+
+
+
+// Start the server for the viewers on the loopback interface
+// -> Returns "1" if the port could be opened
+uint8_t stream_serve(uint16_t port)
+{
+    struct sockaddr_in addr;
+    int                one = 1;
+
+    for(uint8_t i=0; i<3; i++)
+    {
+        frames[i].bits = malloc(STREAM_BITS_MAX);
+        if(frames[i].bits == NULL)
+        {
+            return 0;
+        }
+    }
+    for(uint8_t i=0; i<STREAM_CLIENTS_MAX; i++)
+    {
+        clients[i].fd = -1;
+    }
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(listen_fd < 0)
+    {
+        return 0;
+    }
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(    (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        || (listen(listen_fd, STREAM_CLIENTS_MAX) != 0)
+        || pipe(wake_pipe)
+      )
+    {
+        close(listen_fd);
+        listen_fd = -1;
+        return 0;
+    }
+    fcntl(listen_fd, F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+    if(pthread_create(&server, NULL, stream_server, NULL))
+    {
+        exit(1);
+    }
+    serving = 1;
+    return 1;
+}
+
+
+
+// Add a generation for the viewers (only for the simulation thread, never waits for a viewer)
+void stream_add(const grid_t * grid, uint16_t width, uint16_t height, uint32_t generation)
+{
+    stream_frame_t *frame;
+
+    if(!serving || (atomic_load(&client_cnt) == 0))
+    {
+        return;
+    }
+
+    grid_pack(grid, width, height, frame_fill->bits);
+    frame_fill->generation = generation;
+    frame_fill->width      = width;
+    frame_fill->height     = height;
+
+    // Replace the generation which has not been taken by the server thread yet
+    pthread_mutex_lock(&server_mutex);
+    frame       = frame_ready;
+    frame_ready = frame_fill;
+    frame_fill  = frame;
+    ready_seq   = (ready_seq == UINT32_MAX ? 1 : ready_seq + 1);
+    pthread_mutex_unlock(&server_mutex);
+
+    if(!atomic_exchange(&wake_pending, 1))
+    {
+        if(write(wake_pipe[1], "", 1) < 0)
+        {
+            atomic_store(&wake_pending, 0);
+        }
+    }
+}
+
+
+
+// Function to read a number of bytes from the server
+// -> Returns "0" if the connection has been closed
+static uint8_t stream_read(void * buf, uint32_t len)
+{
+    uint8_t *p = buf;
+
+    while(len > 0)
+    {
+        ssize_t n = recv(conn_fd, p, len, 0);
+        if(n > 0)
+        {
+            p   += n;
+            len -= n;
+        }
+        else if((n < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+
+// Receiver thread (applies the generations from the server)
+static void * stream_receiver(void * args)
+{
+    uint8_t           *bits = malloc(STREAM_BITS_MAX);
+    uint8_t           *runs = malloc(RECORDER_RUNS_MAX(STREAM_BITS_MAX));
+    recorder_record_t rec;
+    uint16_t          width  = 0;
+    uint16_t          height = 0;
+
+    (void)args;
+    while((bits != NULL) && (runs != NULL) && stream_read(&rec, sizeof(rec)))
+    {
+        uint32_t size = GRID_PACKED_SIZE(rec.width, rec.height);
+
+        if(    (rec.width  == 0) || (rec.width  > GRID_WIDTH_MAX)
+            || (rec.height == 0) || (rec.height > GRID_HEIGHT_MAX)
+            || (rec.size > RECORDER_RUNS_MAX(STREAM_BITS_MAX))
+            || ((rec.type != RECORDER_TYPE_KEYFRAME) && (rec.type != RECORDER_TYPE_DELTA))
+            || ((rec.type == RECORDER_TYPE_DELTA) && ((rec.width != width) || (rec.height != height)))
+            || !stream_read(runs, rec.size)
+          )
+        {
+            break;
+        }
+        if(rec.type == RECORDER_TYPE_KEYFRAME)
+        {
+            memset(bits, 0, size);
+            width  = rec.width;
+            height = rec.height;
+        }
+        recorder_apply_runs(bits, size, runs, rec.size);
+
+        // Replace the generation which has not been taken by the simulation thread yet
+        pthread_mutex_lock(&remote_mutex);
+        memcpy(remote_frame.bits, bits, size);
+        remote_frame.generation = rec.generation;
+        remote_frame.width      = width;
+        remote_frame.height     = height;
+        remote_fresh            = 1;
+        pthread_cond_signal(&remote_cond);
+        pthread_mutex_unlock(&remote_mutex);
+    }
+
+    pthread_mutex_lock(&remote_mutex);
+    connected = 0;
+    pthread_cond_signal(&remote_cond);
+    pthread_mutex_unlock(&remote_mutex);
+    free(bits);
+    free(runs);
+    return NULL;
+}
+
+
+
+// Connect to a server ("[host:]port", default host 127.0.0.1) and start receiving
+// -> Returns "1" if connected
+uint8_t stream_connect(const char * address)
+{
+    struct addrinfo        hints;
+    struct addrinfo        *res, *ai;
+    recorder_file_header_t header;
+    char                   host[64] = "127.0.0.1";
+    const char             *port    = strrchr(address, ':');
+
+    if(port != NULL)
+    {
+        snprintf(host, sizeof(host), "%.*s", (int)(port - address), address);
+        port++;
+    }
+    else
+    {
+        port = address;
+    }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host, port, &hints, &res) != 0)
+    {
+        return 0;
+    }
+    for(ai=res; ai!=NULL; ai=ai->ai_next)
+    {
+        conn_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if(conn_fd < 0)
+            continue;
+        if(connect(conn_fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(conn_fd);
+        conn_fd = -1;
+    }
+    freeaddrinfo(res);
+    if(conn_fd < 0)
+    {
+        return 0;
+    }
+    stream_set_socket(conn_fd, 0);
+
+    remote_frame.bits = malloc(STREAM_BITS_MAX);
+    if(    (remote_frame.bits == NULL)
+        || !stream_read(&header, sizeof(header))
+        || (memcmp(header.magic, RECORDER_MAGIC, sizeof(header.magic)) != 0)
+        || (header.version != RECORDER_VERSION)
+      )
+    {
+        close(conn_fd);
+        conn_fd = -1;
+        return 0;
+    }
+    snprintf(remote_name, sizeof(remote_name), "%s:%s", host, port);
+    connected = 1;
+    remote    = 1;
+    if(pthread_create(&receiver, NULL, stream_receiver, NULL))
+    {
+        exit(1);
+    }
+    return 1;
+}
+
+
+
+// Return "1" if connected to a server (also after the connection has been closed by the server)
+uint8_t stream_is_remote(void)
+{
+    return remote;
+}
+
+
+
+// Wait for a new generation from the server
+// -> Returns "1" if there is a new generation, "0" after "timeout_ms" or if the connection is closed
+uint8_t stream_wait(uint32_t timeout_ms)
+{
+    struct timespec deadline;
+    uint8_t         fresh;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec  += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if(deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&remote_mutex);
+    while(!remote_fresh && connected)
+    {
+        if(pthread_cond_timedwait(&remote_cond, &remote_mutex, &deadline) != 0)
+            break;
+    }
+    fresh = remote_fresh;
+    pthread_mutex_unlock(&remote_mutex);
+    return fresh;
+}
+
+
+
+// Set the newest generation from the server into the center of a grid
+// -> Returns the generation of the server
+uint32_t stream_set_to_grid(grid_t * grid)
+{
+    uint32_t generation;
+
+    pthread_mutex_lock(&remote_mutex);
+    if(remote_frame.width > 0)
+    {
+        grid_unpack(grid, remote_frame.bits, remote_frame.width, remote_frame.height);
+    }
+    generation   = remote_frame.generation;
+    remote_fresh = 0;
+    pthread_mutex_unlock(&remote_mutex);
+    return generation;
+}
+
+
+
+// Get the name of the server ("host:port")
+const char * stream_get_name(void)
+{
+    return remote_name;
+}
+
+
+
+// Stop the server or close the connection to the server
+void stream_close(void)
+{
+    if(serving)
+    {
+        atomic_store(&server_stop, 1);
+        if(write(wake_pipe[1], "", 1) >= 0)
+        {
+            pthread_join(server, NULL);
+        }
+        close(listen_fd);
+        serving = 0;
+    }
+    if(remote && (conn_fd >= 0))
+    {
+        shutdown(conn_fd, SHUT_RDWR);
+        pthread_join(receiver, NULL);
+        close(conn_fd);
+        conn_fd = -1;
+    }
+}
@@ -0,0 +1,47 @@
+
+// File:    stream.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Streaming of the generations over TCP to viewers (see stream.c)
+
+#ifndef __STREAM_H
+#define __STREAM_H
+
+#include <stdint.h>
+#include "grid.h"
+
+#define STREAM_CLIENTS_MAX 16 // Viewers of a server at the same time
+
+
+
+// Start the server for the viewers on the loopback interface
+// -> Returns "1" if the port could be opened
+uint8_t stream_serve(uint16_t port);
+
+// Add a generation for the viewers (only for the simulation thread, never waits for a viewer)
+void stream_add(const grid_t * grid, uint16_t width, uint16_t height, uint32_t generation);
+
+// Connect to a server ("[host:]port", default host 127.0.0.1) and start receiving
+// -> Returns "1" if connected
+uint8_t stream_connect(const char * address);
+
+// Return "1" if connected to a server (also after the connection has been closed by the server)
+uint8_t stream_is_remote(void);
+
+// Wait for a new generation from the server
+// -> Returns "1" if there is a new generation, "0" after "timeout_ms" or if the connection is closed
+uint8_t stream_wait(uint32_t timeout_ms);
+
+// Set the newest generation from the server into the center of a grid
+// -> Returns the generation of the server
+uint32_t stream_set_to_grid(grid_t * grid);
+
+// Get the name of the server ("host:port")
+const char * stream_get_name(void);
+
+// Stop the server or close the connection to the server
+void stream_close(void);
+
+
+
+#endif // __STREAM_H
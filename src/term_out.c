@@ -0,0 +1,219 @@
+
+// File:    term_out.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Direct ANSI output of the grid area (bypasses ncurses).
+//          Every frame is built into one reusable byte buffer and written with a single write().
+//          Only the characters which differ from the last frame are sent. Unchanged spans
+//          within a row are skipped with a relative cursor movement or are sent again when
+//          this is shorter. The cursor position and attributes are saved and restored, so
+//          ncurses does not notice the output.
+//          The rows are encoded in parallel by worker threads into separate row buffers,
+//          which are then copied in order into the frame buffer.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include "config.h"
+#include "term_out.h"
+
+#define TERM_OUT_ESC_MAX 16 // Longest escape sequence for a cursor movement: "\e[1000;1000H"
+
+static uint16_t out_top;
+static uint16_t out_left;
+static uint16_t out_rows;
+static uint16_t out_cols;
+static uint32_t *cells_prev;   // Glyph codes on the terminal
+static uint32_t *cells_cur;    // Glyph codes of the current frame
+static uint8_t  invalid = 1;   // Complete redraw needed
+static char     *row_buf;      // Output buffers for every row (row_cap bytes each)
+static size_t   *row_len;
+static size_t   row_cap;
+static char     *frame_buf;    // Output buffer for one frame
+static size_t   frame_len = 0;
+
+
+
+// Append the bytes of one glyph code to the buffer
+static inline char * put_glyph(char * p, uint32_t code)
+{
+    char bytes[4];
+    memcpy(bytes, &code, 4);
+    for(uint8_t i=0; (i<4) && bytes[i]; i++)
+        *p++ = bytes[i];
+    return p;
+}
+
+
+
+// Initialize the output area (position and size in terminal characters)
+void term_out_init(uint16_t top, uint16_t left, uint16_t rows, uint16_t cols)
+{
+    size_t cells = (size_t)rows * cols;
+
+    out_top  = top;
+    out_left = left;
+    out_rows = rows;
+    out_cols = cols;
+
+    row_cap    = (size_t)cols * (4 + TERM_OUT_ESC_MAX) + TERM_OUT_ESC_MAX;
+    cells_prev = realloc(cells_prev, (cells ? cells : 1) * sizeof(uint32_t));
+    cells_cur  = realloc(cells_cur,  (cells ? cells : 1) * sizeof(uint32_t));
+    row_buf    = realloc(row_buf,    (rows ? rows : 1) * row_cap);
+    row_len    = realloc(row_len,    (rows ? rows : 1) * sizeof(size_t));
+    frame_buf  = realloc(frame_buf,  (size_t)rows * row_cap + 32);
+    if((cells_prev == NULL) || (cells_cur == NULL) || (row_buf == NULL) || (row_len == NULL) || (frame_buf == NULL))
+    {
+        exit(1);
+    }
+
+    frame_len = 0;
+    invalid   = 1;
+}
+
+
+
+// Force a complete redraw of the output area with the next frame
+void term_out_invalidate(void)
+{
+    invalid = 1;
+}
+
+
+
+// Encode one row into its row buffer (only changed spans)
+static void encode_row(uint16_t row, term_out_row_fn_t row_fn)
+{
+    uint32_t *prev = &cells_prev[(size_t)row * out_cols];
+    uint32_t *cur  = &cells_cur[(size_t)row * out_cols];
+    char     *p    = &row_buf[row * row_cap];
+    int32_t  cursor = -1; // Column of the cursor in this row (-1: unknown)
+
+    row_fn(row, cur, out_cols);
+
+    for(uint16_t col=0; col<out_cols; col++)
+    {
+        if(!invalid && (cur[col] == prev[col]))
+            continue;
+
+        if(cursor < 0)
+        {
+            // Absolute position (1-based)
+            p += sprintf(p, "\033[%u;%uH", out_top+row+1, out_left+col+1);
+        }
+        else if(cursor < col)
+        {
+            // Skip the unchanged span: Relative movement or resend the glyphs (whatever is shorter)
+            uint16_t skip = col - cursor;
+            char     esc[TERM_OUT_ESC_MAX];
+            int      esc_len = sprintf(esc, "\033[%uC", skip);
+            char     *q = p;
+            for(uint16_t i=cursor; (i<col) && ((q-p) <= esc_len); i++)
+                q = put_glyph(q, prev[i]);
+            if((q-p) > esc_len)
+            {
+                memcpy(p, esc, esc_len);
+                p += esc_len;
+            }
+            else
+            {
+                p = q;
+            }
+        }
+        p = put_glyph(p, cur[col]);
+        prev[col] = cur[col];
+        cursor = col+1;
+    }
+
+    row_len[row] = p - &row_buf[row * row_cap];
+}
+
+
+
+// Encode a subset of rows (thread function)
+typedef struct
+{
+    uint16_t          row_beg;
+    uint16_t          row_cnt;
+    term_out_row_fn_t row_fn;
+} encode_thread_arg_t;
+
+static void * encode_rows(void * args)
+{
+    encode_thread_arg_t *arg = (encode_thread_arg_t*)args;
+
+    for(uint16_t row=arg->row_beg; row<(arg->row_beg+arg->row_cnt); row++)
+    {
+        encode_row(row, arg->row_fn);
+    }
+    return NULL;
+}
+
+
+
+// Build the next frame into the output buffer (only changed spans are encoded)
+void term_out_frame(term_out_row_fn_t row_fn)
+{
+    uint16_t thread_cnt = sysconf(_SC_NPROCESSORS_ONLN); // Number of active Cores
+    if(thread_cnt > out_rows) thread_cnt = out_rows;
+    if(thread_cnt < 1)        thread_cnt = 1;
+    pthread_t           threads[thread_cnt];
+    encode_thread_arg_t args[thread_cnt];
+
+    // Encode the rows in parallel (the calling thread takes the first subset)
+    for(int i=0; i<thread_cnt; i++)
+    {
+        uint16_t row_beg = ((int)out_rows * i) / thread_cnt;
+        uint16_t row_end = ((int)out_rows * (i+1)) / thread_cnt;
+        args[i].row_beg = row_beg;
+        args[i].row_cnt = row_end - row_beg;
+        args[i].row_fn  = row_fn;
+        if((i > 0) && pthread_create(&threads[i], NULL, encode_rows, (void *)&args[i]))
+        {
+            exit(1);
+        }
+    }
+    encode_rows(&args[0]);
+    for(int i=1; i<thread_cnt; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Copy the rows in order into the frame buffer
+    char *p = frame_buf;
+    p += sprintf(p, "\0337\033[0;1m"); // Save cursor and attributes, bold for living cells
+    for(uint16_t row=0; row<out_rows; row++)
+    {
+        memcpy(p, &row_buf[row * row_cap], row_len[row]);
+        p += row_len[row];
+    }
+    p += sprintf(p, "\0338"); // Restore cursor and attributes for ncurses
+
+    frame_len = p - frame_buf;
+    invalid   = 0;
+}
+
+
+
+// Write the output buffer to the terminal with a single write()
+void term_out_write(void)
+{
+    size_t pos = 0;
+
+    while(pos < frame_len)
+    {
+        ssize_t ret = write(STDOUT_FILENO, frame_buf + pos, frame_len - pos);
+        if(ret < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        pos += ret;
+    }
+    frame_len = 0;
+}
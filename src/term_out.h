@@ -0,0 +1,32 @@
+
+// File:    term_out.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Direct ANSI output of the grid area (bypasses ncurses)
+
+#ifndef __TERM_OUT_H
+#define __TERM_OUT_H
+
+#include <stdint.h>
+
+// Function to encode one row of the output area into glyph codes
+// -> One glyph code per terminal character: UTF-8 bytes in memory order, unused bytes are zero
+typedef void (*term_out_row_fn_t)(uint16_t row, uint32_t * cells, uint16_t cols);
+
+
+
+// Initialize the output area (position and size in terminal characters)
+void term_out_init(uint16_t top, uint16_t left, uint16_t rows, uint16_t cols);
+
+// Force a complete redraw of the output area with the next frame
+void term_out_invalidate(void);
+
+// Build the next frame into the output buffer (only changed spans are encoded)
+void term_out_frame(term_out_row_fn_t row_fn);
+
+// Write the output buffer to the terminal with a single write()
+void term_out_write(void);
+
+
+
+#endif // __TERM_OUT_H
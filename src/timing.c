@@ -0,0 +1,185 @@
+
+// File:    timing.c
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Monotonic time and deadline based scheduling of the generation steps.
+//          Every step has an absolute deadline on CLOCK_MONOTONIC. The next deadline is the
+//          last deadline plus the period, so the calculation and drawing time does not add up
+//          (no drift). If a deadline is missed by more than one period, the missed steps are
+//          counted and the deadlines restart from now (no catch up burst).
+//          The waiting is done with poll() on a timerfd (Linux) and a file descriptor for
+//          wake ups, so commands are handled immediately and no CPU is used while stopped.
+
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#if(defined __linux__)
+    #include <sys/timerfd.h>
+#endif
+#include "config.h"
+#include "timing.h"
+
+// Periods of the speed levels in nanoseconds (0: Stop, 1: As fast as possible)
+static const uint64_t speed_period_ns[] =
+{
+    0,          // 0: Stop
+    3333333333, // 1: 0.3 Hz
+    1000000000, // 2:   1 Hz
+     333333333, // 3:   3 Hz
+     100000000, // 4:  10 Hz
+      33333333, // 5:  30 Hz
+      10000000, // 6: 100 Hz
+       3333333, // 7: 300 Hz
+       1000000, // 8:  1 kHz
+             1  // 9: As fast as possible
+};
+#define SPEED_CNT (sizeof(speed_period_ns) / sizeof(speed_period_ns[0]))
+
+// Turbo levels (SPEED_CNT...TIMING_SPEED_MAX): As fast as possible like level 9, but every step is a
+// batch of 2^k generations and only the last one is recorded (see grid_update_turbo())
+
+static uint64_t period_ns = 0;
+static uint64_t deadline_ns;
+static _Atomic uint32_t missed = 0;
+static int      timer_fd = -1;
+
+
+
+// Get monotonic time in nanoseconds
+uint64_t timing_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+
+// Get monotonic time in milliseconds
+uint64_t timing_now_ms(void)
+{
+    return timing_now_ns() / 1000000;
+}
+
+
+
+// Set the rate of the generation steps for a speed level (restarts the deadlines)
+void timing_set_speed(uint8_t speed)
+{
+    period_ns   = timing_get_period_ns(speed);
+    deadline_ns = timing_now_ns() + (period_ns > 1 ? period_ns : 0);
+    atomic_store(&missed, 0);
+}
+
+
+
+// Get the rate of a speed level in Hz (0: Stop, negative: As fast as possible)
+float timing_get_rate(uint8_t speed)
+{
+    uint64_t period = timing_get_period_ns(speed);
+
+    if(period == 1)
+        return -1;
+    else if(period == 0)
+        return 0;
+    else
+        return 1e9 * timing_get_batch(speed) / (float)period;
+}
+
+
+
+// Get the period of the steps of a speed level in nanoseconds (0: Stop, 1: As fast as possible)
+uint64_t timing_get_period_ns(uint8_t speed)
+{
+    if(speed < SPEED_CNT)
+        return speed_period_ns[speed];
+    else
+        return 1;
+}
+
+
+
+// Get the number of generations per step of a speed level (turbo levels: 2^k)
+uint32_t timing_get_batch(uint8_t speed)
+{
+    if((speed < SPEED_CNT) || (speed > TIMING_SPEED_MAX))
+        return 1;
+    else
+        return (uint32_t)1 << (speed - SPEED_CNT + 1);
+}
+
+
+
+// Wait for the next deadline or until "wake_fd" is readable (the wake_fd is drained)
+// -> Returns "1" if the deadline has been reached and the next step is due
+uint8_t timing_wait(int wake_fd)
+{
+    uint64_t now = timing_now_ns();
+
+    if(period_ns == 1) // As fast as possible
+    {
+        return 1;
+    }
+
+    if((period_ns == 0) || (now < deadline_ns))
+    {
+        struct pollfd fds[2] = {{.fd = wake_fd, .events = POLLIN}, {.fd = -1, .events = POLLIN}};
+        int timeout = -1;
+
+        if(period_ns != 0)
+        {
+            #if(defined __linux__)
+                // Absolute deadline with nanosecond resolution
+                struct itimerspec its = {0};
+                if(timer_fd < 0)
+                    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+                its.it_value.tv_sec  = deadline_ns / 1000000000;
+                its.it_value.tv_nsec = deadline_ns % 1000000000;
+                timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+                fds[1].fd = timer_fd;
+            #else
+                timeout = (deadline_ns - now + 999999) / 1000000;
+            #endif
+        }
+
+        if(poll(fds, 2, timeout) > 0)
+        {
+            if(fds[0].revents & POLLIN)
+            {
+                char buf[64];
+                while(read(wake_fd, buf, sizeof(buf)) == sizeof(buf));
+            }
+            if(fds[1].revents & POLLIN)
+            {
+                uint64_t expirations;
+                if(read(timer_fd, &expirations, sizeof(expirations))) {}
+            }
+        }
+
+        now = timing_now_ns();
+        if((period_ns == 0) || (now < deadline_ns))
+            return 0;
+    }
+
+    // Deadline reached -> Next deadline (with drift compensation)
+    deadline_ns += period_ns;
+    if(now >= deadline_ns)
+    {
+        // More than one period late -> Count the missed steps and restart from now
+        uint32_t late = (now - deadline_ns) / period_ns + 1;
+        atomic_fetch_add(&missed, late);
+        deadline_ns = now + period_ns;
+    }
+    return 1;
+}
+
+
+
+// Get number of missed deadlines since the last timing_set_speed()
+uint32_t timing_get_missed(void)
+{
+    return atomic_load(&missed);
+}
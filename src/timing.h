@@ -0,0 +1,44 @@
+
+// File:    timing.h
+// Author:  Martin Ochs
+// License: MIT
+// Brief:   Monotonic time and deadline based scheduling of the generation steps
+
+#ifndef __TIMING_H
+#define __TIMING_H
+
+#include <stdint.h>
+
+#define TIMING_SPEED_MAX 19 // Levels 10...19: Turbo with batches of 2^1...2^10 generations
+#define TIMING_TURBO_BUDGET_NS 16666666 // Longest calculation of one turbo batch (one frame of the drawing at 60 Hz)
+
+
+
+// Get monotonic time in nanoseconds
+uint64_t timing_now_ns(void);
+
+// Get monotonic time in milliseconds
+uint64_t timing_now_ms(void);
+
+// Set the rate of the generation steps for a speed level (restarts the deadlines, 0: Wait only for wake_fd)
+void timing_set_speed(uint8_t speed);
+
+// Get the rate of a speed level in Hz (0: Stop, negative: As fast as possible)
+float timing_get_rate(uint8_t speed);
+
+// Get the period of the steps of a speed level in nanoseconds (0: Stop, 1: As fast as possible)
+uint64_t timing_get_period_ns(uint8_t speed);
+
+// Get the number of generations per step of a speed level (turbo levels: 2^k)
+uint32_t timing_get_batch(uint8_t speed);
+
+// Wait for the next deadline or until "wake_fd" is readable (the wake_fd is drained)
+// -> Returns "1" if the deadline has been reached and the next step is due
+uint8_t timing_wait(int wake_fd);
+
+// Get number of missed deadlines since the last timing_set_speed()
+uint32_t timing_get_missed(void);
+
+
+
+#endif // __TIMING_H